@@ -0,0 +1,81 @@
+/* See LICENSE file for copyright and license details. */
+#include "../util.c"
+#include "../tests/fmt_human_ref.h"
+
+#include <time.h>
+
+/* numbers formatted per measurement */
+#define NUMS 1000000
+
+/* measurements, of which the fastest is reported */
+#define PASSES 5
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t
+rnd(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed;
+}
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EXIT_FAILURE, "clock_gettime");
+
+	return timespec_to_nsec(&ts);
+}
+
+/* fastest pass, in nanoseconds per number */
+static double
+measure(const char *(*fn)(uintmax_t, int), const uintmax_t *nums)
+{
+	volatile char sink;
+	uint64_t t, best = UINT64_MAX;
+	size_t i, j;
+
+	for (i = 0; i < PASSES; i++) {
+		t = now();
+		for (j = 0; j < NUMS; j++)
+			sink = fn(nums[j], 1024)[0];
+		t = now() - t;
+		best = MIN(best, t);
+	}
+	(void)sink;
+
+	return (double)best / NUMS;
+}
+
+/* numbers of random bit length, like byte counts of all magnitudes */
+int
+main(void)
+{
+	const struct {
+		const char *name;
+		const char *(*fn)(uintmax_t, int);
+	} fns[] = {
+		{ "fmt_human", fmt_human },
+		{ "long double %.1Lf", ref_human },
+		{ "fmt_human_3", fmt_human_3 },
+		{ "long double %.3Lg", ref_human_3 },
+	};
+	uintmax_t *nums;
+	size_t i;
+
+	nums = ecalloc(NUMS, sizeof(*nums));
+	for (i = 0; i < NUMS; i++)
+		nums[i] = rnd() >> rnd() % 64;
+
+	for (i = 0; i < LEN(fns); i++)
+		printf("%-18s %6.1f ns\n", fns[i].name, measure(fns[i].fn, nums));
+	free(nums);
+
+	return 0;
+}
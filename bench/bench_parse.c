@@ -0,0 +1,161 @@
+/* See LICENSE file for copyright and license details. */
+#include "../parse.c"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* rows of counters per table, about as many as /proc/interrupts has */
+#define ROWS 60
+
+/* passes per measurement, of which the fastest is reported */
+#define PASSES 200
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t
+rnd(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed;
+}
+
+/* a table laid out like /proc/interrupts, with a column per CPU */
+static char *
+table(size_t cpus, size_t *size)
+{
+	const size_t cap = (ROWS + 1) * (cpus * 11 + 64);
+	char *text, *p;
+	size_t r, c;
+
+	text = ecalloc(1, cap);
+	p = text + sprintf(text, "     ");
+	for (c = 0; c < cpus; c++)
+		p += sprintf(p, " %10s", bprintf("CPU%zu", c));
+	*p++ = '\n';
+	for (r = 0; r < ROWS; r++) {
+		p += sprintf(p, "%4zu:", r);
+		/* mostly small counts, some large ones, as in the real file */
+		for (c = 0; c < cpus; c++)
+			p += sprintf(p, " %10" PRIu64, rnd() % 8 ? rnd() % 1000 :
+			             rnd() % 4000000000);
+		p += sprintf(p, "  IR-PCI-MSI %zu-edge  dev%zu\n", r, r);
+	}
+	*size = p - text;
+
+	return text;
+}
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EXIT_FAILURE, "clock_gettime");
+
+	return timespec_to_nsec(&ts);
+}
+
+/* the previous way of reading a row, number by number with strtoumax */
+static size_t
+rows_strtoumax(const char *text, uintmax_t *v, size_t cpus)
+{
+	const char *p = strchr(text, '\n') + 1;
+	size_t r, c, sum = 0;
+	char *end;
+
+	for (r = 0; r < ROWS; r++) {
+		p = strchr(p, ':') + 1;
+		for (c = 0; c < cpus; c++) {
+			v[c] = strtoumax(p, &end, 10);
+			p = end;
+		}
+		sum += v[0];
+		p = strchr(p, '\n') + 1;
+	}
+
+	return sum;
+}
+
+static size_t
+rows_parse(const char *text, uintmax_t *v, size_t cpus)
+{
+	struct parser ps;
+	size_t r, sum = 0;
+
+	parse_init(&ps, "bench", text);
+	parse_line(&ps);
+	for (r = 0; r < ROWS; r++) {
+		ps.p = strchr(ps.p, ':') + 1;
+		if (parse_nums(&ps, v, cpus) != cpus)
+			errx(EXIT_FAILURE, "bench: short row %zu", r);
+		sum += v[0];
+		parse_line(&ps);
+	}
+
+	return sum;
+}
+
+/* fastest pass, in microseconds */
+static double
+measure(size_t (*fn)(const char *, uintmax_t *, size_t), const char *text,
+        uintmax_t *v, size_t cpus)
+{
+	volatile size_t sink;
+	uint64_t t, best = UINT64_MAX;
+	size_t i;
+
+	for (i = 0; i < PASSES; i++) {
+		t = now();
+		sink = fn(text, v, cpus);
+		t = now() - t;
+		best = MIN(best, t);
+	}
+	(void)sink;
+
+	return best / 1E3;
+}
+
+int
+main(void)
+{
+	static const size_t sizes[] = { 256, 1024 };
+	const struct {
+		const char *name;
+		size_t (*fn)(const char **, const char *, uintmax_t *, size_t);
+		int ok;
+	} scanners[] = {
+		{ "scalar", scan_scalar, 1 },
+#if defined(__x86_64__) || defined(__i386__)
+		{ "sse2", scan_sse2, __builtin_cpu_supports("sse2") },
+		{ "avx2", scan_avx2, __builtin_cpu_supports("avx2") },
+#endif
+	};
+	uintmax_t *v;
+	size_t i, j, size;
+	char *text;
+
+	pthread_once(&once, select_scan);
+	for (i = 0; i < LEN(sizes); i++) {
+		text = table(sizes[i], &size);
+		v = ecalloc(sizes[i], sizeof(*v));
+		printf("%4zu CPUs, %4zu KiB:  strtoumax %7.1f us", sizes[i],
+		       size / 1024, measure(rows_strtoumax, text, v, sizes[i]));
+		for (j = 0; j < LEN(scanners); j++) {
+			if (!scanners[j].ok)
+				continue;
+			scan = scanners[j].fn;
+			printf("  %s %7.1f us", scanners[j].name,
+			       measure(rows_parse, text, v, sizes[i]));
+		}
+		putchar('\n');
+		free(v);
+		free(text);
+	}
+
+	return 0;
+}
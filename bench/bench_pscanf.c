@@ -0,0 +1,138 @@
+/* See LICENSE file for copyright and license details. */
+#include "../parse.h"
+#include "../util.h"
+
+#include <err.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* calls per measurement */
+#define CALLS 200000
+
+/* measurements, of which the fastest is reported */
+#define PASSES 5
+
+/* a file holding a single number, present on every Linux system */
+#define UINT_FILE "/proc/sys/kernel/pid_max"
+
+/* the first line of /proc/stat */
+static const char stat_text[] =
+	"cpu  10132153 290696 3084719 46828483 16683 0 25195 0 0 0\n";
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EXIT_FAILURE, "clock_gettime");
+
+	return timespec_to_nsec(&ts);
+}
+
+static uintmax_t
+row_sscanf(void)
+{
+	uintmax_t v[10];
+
+	if (sscanf(stat_text, "%*s %ju %ju %ju %ju %ju %ju %ju %ju %ju %ju",
+	           &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7],
+	           &v[8], &v[9]) != 10)
+		errx(EXIT_FAILURE, "sscanf: Short row");
+
+	return v[3];
+}
+
+static uintmax_t
+row_parse(void)
+{
+	uintmax_t v[10];
+	struct parser ps;
+
+	parse_init(&ps, "/proc/stat", stat_text);
+	if (parse_word(&ps, "cpu") < 0 || parse_row(&ps, v, LEN(v)) < 0)
+		exit(EXIT_FAILURE);
+
+	return v[3];
+}
+
+/* the way numbers were read before readfile(), for comparison */
+static uintmax_t
+uint_fscanf(void)
+{
+	uintmax_t v;
+	FILE *fp;
+
+	if (!(fp = fopen(UINT_FILE, "r")))
+		err(EXIT_FAILURE, "fopen '%s'", UINT_FILE);
+	if (fscanf(fp, "%ju", &v) != 1)
+		errx(EXIT_FAILURE, "fscanf '%s': No number", UINT_FILE);
+	(void)fclose(fp);
+
+	return v;
+}
+
+static uintmax_t
+uint_pscanf(void)
+{
+	uintmax_t v;
+
+	if (pscanf(UINT_FILE, "%ju", &v) != 1)
+		exit(EXIT_FAILURE);
+
+	return v;
+}
+
+static uintmax_t
+uint_readuint(void)
+{
+	uintmax_t v;
+
+	if (readuint(UINT_FILE, &v) < 0)
+		exit(EXIT_FAILURE);
+
+	return v;
+}
+
+/* fastest pass, in nanoseconds per call */
+static double
+measure(uintmax_t (*fn)(void))
+{
+	volatile uintmax_t sink;
+	uint64_t t, best = UINT64_MAX;
+	size_t i, j;
+
+	for (i = 0; i < PASSES; i++) {
+		t = now();
+		for (j = 0; j < CALLS; j++)
+			sink = fn();
+		t = now() - t;
+		best = MIN(best, t);
+	}
+	(void)sink;
+
+	return (double)best / CALLS;
+}
+
+int
+main(void)
+{
+	const struct {
+		const char *name;
+		uintmax_t (*fn)(void);
+	} fns[] = {
+		{ "stat row, sscanf", row_sscanf },
+		{ "stat row, parser", row_parse },
+		{ "number, fopen+fscanf", uint_fscanf },
+		{ "number, pscanf", uint_pscanf },
+		{ "number, readuint", uint_readuint },
+	};
+	size_t i;
+
+	for (i = 0; i < LEN(fns); i++)
+		printf("%-21s %7.1f ns\n", fns[i].name, measure(fns[i].fn));
+
+	return 0;
+}
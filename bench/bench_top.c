@@ -0,0 +1,109 @@
+/* See LICENSE file for copyright and license details. */
+#include "../slstatus.h"
+#include "../util.h"
+
+#include <err.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* idle processes started to fill the process table */
+#define PROCS 3000
+
+/* update passes measured */
+#define PASSES 20
+
+static pid_t pids[PROCS];
+
+static uint64_t
+now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EXIT_FAILURE, "clock_gettime");
+
+	return timespec_to_nsec(&ts);
+}
+
+static void
+stop(void)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(pids) && pids[i] > 0; i++)
+		(void)kill(pids[i], SIGKILL);
+	for (i = 0; i < LEN(pids) && pids[i] > 0; i++)
+		(void)waitpid(pids[i], NULL, 0);
+}
+
+static void
+start(void)
+{
+	size_t i;
+
+	(void)atexit(stop);
+	for (i = 0; i < LEN(pids); i++) {
+		switch ((pids[i] = fork())) {
+		case -1:
+			err(EXIT_FAILURE, "fork");
+		case 0:
+			/* do not outlive the benchmark if it is killed */
+			(void)prctl(PR_SET_PDEATHSIG, SIGKILL);
+			for (;;)
+				pause();
+		}
+	}
+}
+
+/* average and fastest update pass, in milliseconds */
+static void
+measure(const char *name, const char *(*sample)(void *), void *state)
+{
+	uint64_t t, total = 0, best = UINT64_MAX;
+	const char *res = NULL;
+	size_t i;
+
+	for (i = 0; i < PASSES; i++) {
+		tick++;
+		delta_time = 1;
+		t = now();
+		res = sample(state);
+		t = now() - t;
+		total += t;
+		best = MIN(best, t);
+	}
+
+	printf("%-7s avg %6.2f ms  best %6.2f ms  %s\n", name,
+	       total / 1E6 / PASSES, best / 1E6, res ? res : "n/a");
+}
+
+static const char *
+top_mem_sample(void *arg)
+{
+	return top_mem(arg);
+}
+
+int
+main(void)
+{
+	void *state;
+
+	start();
+	if (top_cpu_ops.init("3", &state) < 0)
+		return 1;
+	/* the first pass only records the processes */
+	tick++;
+	(void)top_cpu_ops.sample(state);
+
+	printf("%d idle processes\n", PROCS);
+	measure("top_cpu", top_cpu_ops.sample, state);
+	measure("top_mem", top_mem_sample, "3");
+	top_cpu_ops.fini(state);
+
+	return 0;
+}
@@ -1,5 +1,6 @@
 /* See LICENSE file for copyright and license details. */
 #include "../meter.h"
+#include "../parse.h"
 #include "../slstatus.h"
 #include "../util.h"
 
@@ -46,13 +47,13 @@ static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 	const char *
 	battery_meter(const char *bat)
 	{
-		int cap_perc;
+		uintmax_t cap_perc;
 		char path[PATH_MAX];
 		wchar_t meter[METER_WIDTH + 1] = {'\0'};
 
 		if (esnprintf(path, sizeof(path), POWER_SUPPLY_CAPACITY, bat) < 0)
 			return NULL;
-		if (pscanf(path, "%d", &cap_perc) != 1)
+		if (readuint(path, &cap_perc) < 0)
 			return NULL;
 
 		left_blocks_meter(cap_perc / 100.0, meter, METER_WIDTH);
@@ -63,12 +64,12 @@ static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 	const char *
 	battery_perc(const char *bat)
 	{
-		int cap_perc;
+		uintmax_t cap_perc;
 		char path[PATH_MAX];
 
 		if (esnprintf(path, sizeof(path), POWER_SUPPLY_CAPACITY, bat) < 0)
 			return NULL;
-		if (pscanf(path, "%d", &cap_perc) != 1)
+		if (readuint(path, &cap_perc) < 0)
 			return NULL;
 
 #ifdef MAX_PCT_99
@@ -76,7 +77,7 @@ static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 			cap_perc = 99;
 #endif
 
-		return bprintf("%d", cap_perc);
+		return bprintf("%ju", cap_perc);
 	}
 
 	const char *
@@ -120,13 +121,13 @@ static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 
 		if (!pick(bat, POWER_SUPPLY_CHARGE, POWER_SUPPLY_ENERGY, path,
 		          sizeof(path)) ||
-		    pscanf(path, "%ju", &charge_now) != 1)
+		    readuint(path, &charge_now) < 0)
 			return NULL;
 
 		if (!strcmp(state, "Discharging")) {
 			if (!pick(bat, POWER_SUPPLY_CURRENT, POWER_SUPPLY_POWER, path,
 			          sizeof(path)) ||
-			    pscanf(path, "%ju", &current_now) != 1)
+			    readuint(path, &current_now) < 0)
 				return NULL;
 
 			if (current_now == 0)
@@ -200,7 +201,7 @@ static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 			cap_perc = 99;
 #endif
 
-		return bprintf("%d", cap_perc);
+		return bprintf("%ju", cap_perc);
 	}
 
 	const char *
@@ -281,7 +282,7 @@ static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 			cap_perc = 99;
 #endif
 
-		return bprintf("%d", cap_perc);
+		return bprintf("%ju", cap_perc);
 	}
 
 	const char *
@@ -6,29 +6,50 @@
 
 #include <err.h>
 #include <math.h>
+#include <stdlib.h>
 #include <time.h>
 
-const char *
-clockdiff([[maybe_unused]] const char *unused)
+static int
+clockdiff_init([[maybe_unused]] const char *unused, void **state)
+{
+	*state = ecalloc(1, sizeof(double));
+
+	return 0;
+}
+
+static const char *
+clockdiff_sample(void *state)
 {
 	double prev_time;
-	static double now_time;
+	double *now_time = state;
 	struct timespec ts;
 
-	prev_time = now_time;
+	prev_time = *now_time;
 
 	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
 		warn("clock_gettime");
 		return NULL;
 	}
 
-	now_time = timespec_to_sec(&ts);
+	*now_time = timespec_to_sec(&ts);
 
 	if (prev_time == 0) {
 		return NULL;
 	}
 
-	return bprintf("%.6f", now_time - prev_time);
+	return bprintf("%.6f", *now_time - prev_time);
+}
+
+const struct component_ops clockdiff_ops = {
+	clockdiff_init, clockdiff_sample, free, CO_NODEDUP,
+};
+
+const char *
+clockdiff([[maybe_unused]] const char *unused)
+{
+	static double now_time;
+
+	return clockdiff_sample(&now_time);
 }
 
 const char *
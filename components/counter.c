@@ -4,9 +4,30 @@
 #include "../slstatus.h"
 #include "../util.h"
 
+#include <stdlib.h>
+
+static int
+counter_init([[maybe_unused]] const char *unused, void **state)
+{
+	*state = ecalloc(1, sizeof(uintmax_t));
+
+	return 0;
+}
+
+static const char *
+counter_sample(void *state)
+{
+	uintmax_t *i = state;
+	return bprintf("%ju", (*i)++);
+}
+
+const struct component_ops counter_ops = {
+	counter_init, counter_sample, free, CO_NODEDUP,
+};
+
 const char *
 counter([[maybe_unused]] const char *unused)
 {
 	static uintmax_t i;
-	return bprintf("%ju", i++);
+	return counter_sample(&i);
 }
@@ -1,12 +1,19 @@
 /* See LICENSE file for copyright and license details. */
+#include "../hist.h"
 #include "../meter.h"
+#include "../parse.h"
 #include "../slstatus.h"
 #include "../util.h"
 
 #include <assert.h>
+#include <err.h>
+#include <limits.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 
 /* percentages will be clamped to 99 */
 #define MAX_PCT_99
@@ -14,14 +21,86 @@
 #define HIST_WIDTH 10
 static_assert(HIST_WIDTH > 0, "HIST_WIDTH must be > 0");
 
+static const struct hist_spec hist_spec = {
+	HIST_WIDTH, HIST_WIDTH, HIST_AVG, 0, 1,
+};
+
 #define METER_WIDTH 10
 static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 
 static const char fill = '=';
 static const char unfill = ' ';
 
+/* CPU states, in the order of the columns of /proc/stat */
+enum {
+	CPU_USER,
+	CPU_NICE,
+	CPU_SYSTEM,
+	CPU_IDLE,
+	CPU_IOWAIT,
+	CPU_IRQ,
+	CPU_SOFTIRQ,
+	CPU_STEAL,
+	CPU_GUEST,      /* included in CPU_USER */
+	CPU_GUEST_NICE, /* included in CPU_NICE */
+	CPU_STATES
+};
+
+static const char *const state_names[CPU_STATES] = {
+	"user", "nice", "system", "idle", "iowait", "irq", "softirq", "steal",
+	"guest", "guest_nice",
+};
+
+/* characters of the states in cpu_stack, idle time is left blank */
+static const char state_fill[CPU_STATES] = {
+	'=', '-', '#', ' ', 'w', 'i', 's', '!', 0, 0,
+};
+
+/* highest CPU number + 1 of the per-core components */
+#define CORES_MAX 1024
+
+/* longest list of online CPUs, room for any set of CPUs below CORES_MAX */
+#define CPULIST_MAX (CORES_MAX * 5 + 1)
+
+/* counters of the online CPUs, indexed by CPU number */
+struct cores {
+	size_t n; /* highest online CPU number + 1 */
+	unsigned char online[CORES_MAX];
+	uintmax_t idle[CORES_MAX], sum[CORES_MAX];
+};
+
+/* current frequencies of the online CPUs, in kHz */
+struct freqs {
+	size_t n; /* highest online CPU number + 1 */
+	char online[CPULIST_MAX]; /* list the files were opened for */
+	unsigned char open[CORES_MAX], ok[CORES_MAX];
+	int fd[CORES_MAX];
+	uintmax_t cur[CORES_MAX], min[CORES_MAX], max[CORES_MAX];
+};
+
+/*
+ * Characters of a strip of n CPUs that fit into buf, the first are shown.
+ * All blocks are encoded in as many bytes as the full one.
+ */
+static size_t
+strip_width(size_t n)
+{
+	char mb[MB_LEN_MAX];
+	mbstate_t ps = { 0 };
+	size_t len;
+
+	if ((len = wcrtomb(mb, lower_blocks_1(1), &ps)) == (size_t)-1)
+		len = MB_CUR_MAX;
+
+	return MIN(n, (sizeof(buf) - 1) / len);
+}
+
 #if defined(__linux__)
+	#include <fcntl.h>
+	#include <unistd.h>
+
 	#define CPU_FREQ "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq"
+	#define CPU_SYSFS "/sys/devices/system/cpu"
 
 	static int
 	calc_freq(uintmax_t *freq)
@@ -29,7 +108,7 @@ static const char unfill = ' ';
 		uintmax_t tmp_freq;
 
 		/* in kHz */
-		if (pscanf(CPU_FREQ, "%ju", &tmp_freq) != 1)
+		if (readuint(CPU_FREQ, &tmp_freq) < 0)
 			return -1;
 
 		*freq = tmp_freq * 1000ULL; // KHz to Hz
@@ -38,17 +117,175 @@ static const char unfill = ' ';
 	}
 
 	static int
-	calc_idle(uintmax_t *idle, uintmax_t *sum)
+	read_times(uintmax_t *t)
+	{
+		const char *procstat;
+		struct parser ps;
+
+		if (!(procstat = snapshot("/proc/stat")))
+			return -1;
+
+		parse_init(&ps, "/proc/stat", procstat);
+		if (parse_word(&ps, "cpu") < 0 ||
+		    parse_row(&ps, t, CPU_STATES) < 0)
+			return -1;
+
+		return 0;
+	}
+
+	static int
+	read_cores(struct cores *c)
+	{
+		uintmax_t a[7], id;
+		const char *procstat;
+		struct parser ps;
+
+		if (!(procstat = snapshot("/proc/stat")))
+			return -1;
+
+		memset(c->online, 0, c->n);
+		c->n = 0;
+
+		/* cpuN lines follow the aggregate one, offline CPUs are left out */
+		parse_init(&ps, "/proc/stat", procstat);
+		for (parse_line(&ps); !strncmp(ps.p, "cpu", 3); parse_line(&ps)) {
+			ps.p += 3;
+			if (parse_uint(&ps, &id) < 0 || parse_row(&ps, a, LEN(a)) < 0)
+				return -1;
+			if (id >= CORES_MAX)
+				continue;
+
+			c->online[id] = 1;
+			c->idle[id] = a[3];
+			c->sum[id] = a[0] + a[1] + a[2] + a[3] + a[5] + a[6];
+			if (id >= c->n)
+				c->n = id + 1;
+		}
+
+		return 0;
+	}
+
+	/* parse a CPU list such as "0-3,6", ignoring CPUs beyond CORES_MAX */
+	static int
+	parse_cpulist(const char *path, const char *text, unsigned char *set,
+	              size_t *n)
+	{
+		uintmax_t first, last, i;
+		struct parser ps;
+
+		*n = 0;
+		parse_init(&ps, path, text);
+		do {
+			if (parse_uint(&ps, &first) < 0)
+				return -1;
+			last = first;
+			if (*ps.p == '-') {
+				ps.p++;
+				if (parse_uint(&ps, &last) < 0)
+					return -1;
+			}
+			for (i = first; i <= last && i < CORES_MAX; i++)
+				set[i] = 1;
+			/* i is past CORES_MAX if the range starts beyond it */
+			*n = MAX(*n, (size_t)MIN(i, (uintmax_t)CORES_MAX));
+		} while (*ps.p++ == ',');
+
+		return 0;
+	}
+
+	/* read a frequency in kHz from a cpufreq attribute at offset 0 */
+	static int
+	pread_khz(int fd, const char *path, uintmax_t *khz)
+	{
+		char text[32];
+		struct parser ps;
+		ssize_t len;
+
+		if ((len = pread(fd, text, sizeof(text) - 1, 0)) < 0)
+			return -1;
+		text[len] = '\0';
+		parse_init(&ps, path, text);
+
+		return parse_uint(&ps, khz);
+	}
+
+	static void
+	close_freq(struct freqs *f, size_t id)
+	{
+		close(f->fd[id]);
+		f->open[id] = f->ok[id] = 0;
+	}
+
+	/* open the current frequency of a CPU, and read its static limits */
+	static void
+	open_freq(struct freqs *f, size_t id)
+	{
+		static const char *const limits[] = {
+			"cpuinfo_min_freq", "cpuinfo_max_freq",
+		};
+		uintmax_t *dst[] = { &f->min[id], &f->max[id] };
+		char path[PATH_MAX];
+		size_t i;
+		int fd;
+
+		/* not every CPU has cpufreq, such as those of most VMs */
+		if (esnprintf(path, sizeof(path), CPU_SYSFS "/cpu%zu/cpufreq/%s",
+		              id, "scaling_cur_freq") < 0 ||
+		    (f->fd[id] = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+			return;
+		f->open[id] = 1;
+
+		for (i = 0; i < LEN(limits); i++) {
+			*dst[i] = 0;
+			if (esnprintf(path, sizeof(path), CPU_SYSFS "/cpu%zu/cpufreq/%s",
+			              id, limits[i]) < 0 ||
+			    (fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+				continue;
+			(void)pread_khz(fd, path, dst[i]);
+			close(fd);
+		}
+	}
+
+	static int
+	read_freqs(struct freqs *f)
 	{
-		uintmax_t a[6];
+		unsigned char online[CORES_MAX] = { 0 };
+		char text[sizeof(f->online)];
+		size_t i, n;
+		ssize_t len;
 
-		/* cpu user nice system idle iowait irq softirq */
-		if (pscanf("/proc/stat", "%*s %ju %ju %ju %ju %*s %ju %ju",
-		           &a[0], &a[1], &a[2], &a[3], &a[4], &a[5]) != 6)
+		/* follow hotplug, the files of offline CPUs disappear */
+		if ((len = readfile(CPU_SYSFS "/online", text, sizeof(text))) < 0)
 			return -1;
+		/* a cut list would end in a partial CPU number */
+		if ((size_t)len == sizeof(text) - 1 && text[len - 1] != '\n') {
+			warnx("%s: List too long", CPU_SYSFS "/online");
+			return -1;
+		}
+		if (strcmp(text, f->online)) {
+			if (parse_cpulist(CPU_SYSFS "/online", text, online, &n) < 0)
+				return -1;
+			for (i = 0; i < MAX(n, f->n); i++) {
+				if (f->open[i] && !online[i])
+					close_freq(f, i);
+				else if (!f->open[i] && online[i])
+					open_freq(f, i);
+			}
+			memcpy(f->online, text, sizeof(text));
+			f->n = n;
+		}
 
-		*idle = a[3];
-		*sum = a[0] + a[1] + a[2] + a[3] + a[4] + a[5];
+		for (i = 0; i < f->n; i++) {
+			if (!f->open[i])
+				continue;
+			if (pread_khz(f->fd[i], "scaling_cur_freq", &f->cur[i]) < 0) {
+				/* offlined and back since the last read, reopen */
+				close_freq(f, i);
+				f->online[0] = '\0';
+				continue;
+			}
+			f->ok[i] = 1;
+		}
 
 		return 0;
 	}
@@ -81,7 +318,7 @@ static const char unfill = ' ';
 	}
 
 	static int
-	calc_idle(uintmax_t *idle, uintmax_t *sum)
+	read_times(uintmax_t *t)
 	{
 		int mib[2];
 		uintmax_t a[CPUSTATES];
@@ -97,8 +334,12 @@ static const char unfill = ' ';
 			return -1;
 		}
 
-		*idle = a[CP_IDLE];
-		*sum = a[CP_USER] + a[CP_NICE] + a[CP_SYS] + a[CP_INTR] + a[CP_IDLE];
+		memset(t, 0, CPU_STATES * sizeof(*t));
+		t[CPU_USER] = a[CP_USER];
+		t[CPU_NICE] = a[CP_NICE];
+		t[CPU_SYSTEM] = a[CP_SYS];
+		t[CPU_IRQ] = a[CP_INTR];
+		t[CPU_IDLE] = a[CP_IDLE];
 
 		return 0;
 	}
@@ -128,7 +369,7 @@ static const char unfill = ' ';
 	}
 
 	static int
-	calc_idle(uintmax_t *idle, uintmax_t *sum)
+	read_times(uintmax_t *t)
 	{
 		long a[CPUSTATES];
 		size_t size;
@@ -140,36 +381,150 @@ static const char unfill = ' ';
 			return -1;
 		}
 
-		*idle = a[CP_IDLE];
-		*sum = a[CP_USER] + a[CP_NICE] + a[CP_SYS] + a[CP_INTR] + a[CP_IDLE];
+		memset(t, 0, CPU_STATES * sizeof(*t));
+		t[CPU_USER] = a[CP_USER];
+		t[CPU_NICE] = a[CP_NICE];
+		t[CPU_SYSTEM] = a[CP_SYS];
+		t[CPU_IRQ] = a[CP_INTR];
+		t[CPU_IDLE] = a[CP_IDLE];
 
 		return 0;
 	}
 #endif
 
-const char *
-cpu_cmeter([[maybe_unused]] const char *unused)
+#if !defined(__linux__)
+	#include <err.h>
+
+	static int
+	read_cores([[maybe_unused]] struct cores *c)
+	{
+		warnx("cpu_core_perc, cpu_cores and cpu_max_perc are not "
+		      "supported on this platform");
+		return -1;
+	}
+
+	static int
+	read_freqs([[maybe_unused]] struct freqs *f)
+	{
+		warnx("cpu_freq_avg, cpu_freq_min, cpu_freq_max and "
+		      "cpu_freq_cores are not supported on this platform");
+		return -1;
+	}
+#endif
+
+/* read the counters at most once per update pass */
+static const uintmax_t *
+calc_times(void)
+{
+	static thread_local uintmax_t times[CPU_STATES];
+	static thread_local uint64_t updated;
+	static thread_local int ok;
+
+	if (stale(&updated))
+		ok = read_times(times) == 0;
+
+	return ok ? times : NULL;
+}
+
+static int
+calc_idle(uintmax_t *idle, uintmax_t *sum)
+{
+	const uintmax_t *t;
+
+	if (!(t = calc_times()))
+		return -1;
+
+	*idle = t[CPU_IDLE];
+	*sum = t[CPU_USER] + t[CPU_NICE] + t[CPU_SYSTEM] + t[CPU_IDLE] +
+	       t[CPU_IRQ] + t[CPU_SOFTIRQ];
+
+	return 0;
+}
+
+/* read the per-core counters at most once per update pass */
+static const struct cores *
+calc_cores(void)
+{
+	static thread_local struct cores cores;
+	static thread_local uint64_t updated;
+	static thread_local int ok;
+
+	if (stale(&updated))
+		ok = read_cores(&cores) == 0;
+
+	return ok ? &cores : NULL;
+}
+
+/* read the per-core frequencies at most once per update pass */
+static const struct freqs *
+calc_freqs(void)
+{
+	static thread_local struct freqs freqs;
+	static thread_local uint64_t updated;
+	static thread_local int ok;
+
+	if (stale(&updated))
+		ok = read_freqs(&freqs) == 0;
+
+	return ok ? &freqs : NULL;
+}
+
+struct cpu_state {
+	uintmax_t idle, sum;
+	struct hist hist; /* of cpu_hist only */
+};
+
+static int
+cpu_init([[maybe_unused]] const char *unused, void **state)
+{
+	*state = ecalloc(1, sizeof(struct cpu_state));
+
+	return 0;
+}
+
+/* fraction of busy time since the previous sample of st */
+static int
+cpu_used(struct cpu_state *st, double *used)
+{
+	const uintmax_t oldidle = st->idle, oldsum = st->sum;
+
+	if (calc_idle(&st->idle, &st->sum) < 0 || oldidle == 0)
+		return -1;
+
+	if (st->sum - oldsum == 0)
+		return -1;
+
+	*used = 1 - (double)(st->idle - oldidle) / (st->sum - oldsum);
+
+	return 0;
+}
+
+static const char *
+cpu_cmeter_sample(void *state)
 {
-	static uintmax_t idle;
-	uintmax_t oldidle = idle;
-	static uintmax_t sum;
-	uintmax_t oldsum = sum;
 	double used;
 	char meter[METER_WIDTH + 1] = {'\0'};
 
-	if (calc_idle(&idle, &sum) < 0 || oldidle == 0)
-		return NULL;
-
-	if (sum - oldsum == 0)
+	if (cpu_used(state, &used) < 0)
 		return NULL;
 
-	used = 1 - (double)(idle - oldidle) / (sum - oldsum);
-
 	left_char_meter(used, meter, METER_WIDTH, fill, unfill);
 
 	return bprintf("%s", meter);
 }
 
+const struct component_ops cpu_cmeter_ops = {
+	cpu_init, cpu_cmeter_sample, free, 0,
+};
+
+const char *
+cpu_cmeter([[maybe_unused]] const char *unused)
+{
+	static struct cpu_state st;
+
+	return cpu_cmeter_sample(&st);
+}
+
 const char *
 cpu_freq([[maybe_unused]] const char *unused)
 {
@@ -182,79 +537,318 @@ cpu_freq([[maybe_unused]] const char *unused)
 	return fmt_human(freq, 1000);
 }
 
+/* average, lowest and highest current frequency of the online CPUs */
+static int
+freq_stats(uintmax_t *avg, uintmax_t *min, uintmax_t *max)
+{
+	const struct freqs *f;
+	uintmax_t sum = 0;
+	size_t i, n = 0;
+
+	if (!(f = calc_freqs()))
+		return -1;
+
+	*min = UINTMAX_MAX;
+	*max = 0;
+	for (i = 0; i < f->n; i++) {
+		if (!f->ok[i])
+			continue;
+		sum += f->cur[i];
+		*min = MIN(*min, f->cur[i]);
+		*max = MAX(*max, f->cur[i]);
+		n++;
+	}
+	if (!n)
+		return -1;
+	*avg = sum / n;
+
+	return 0;
+}
+
 const char *
-cpu_hist([[maybe_unused]] const char *unused)
+cpu_freq_avg([[maybe_unused]] const char *unused)
 {
-	static uintmax_t idle;
-	uintmax_t oldidle = idle;
-	static uintmax_t sum;
-	uintmax_t oldsum = sum;
-	double used;
-	static int initialized;
-	size_t i;
-	static wchar_t hist[HIST_WIDTH + 1];
+	uintmax_t avg, min, max; // kHz
 
-	if (!initialized) {
-		wmemset(hist, ' ', HIST_WIDTH);
-		hist[HIST_WIDTH] = '\0';
-		initialized = 1;
-	}
+	if (freq_stats(&avg, &min, &max) < 0)
+		return NULL;
+
+	return fmt_human(avg * 1000, 1000);
+}
+
+const char *
+cpu_freq_min([[maybe_unused]] const char *unused)
+{
+	uintmax_t avg, min, max; // kHz
+
+	if (freq_stats(&avg, &min, &max) < 0)
+		return NULL;
+
+	return fmt_human(min * 1000, 1000);
+}
+
+const char *
+cpu_freq_max([[maybe_unused]] const char *unused)
+{
+	uintmax_t avg, min, max; // kHz
 
-	if (calc_idle(&idle, &sum) < 0 || oldidle == 0)
+	if (freq_stats(&avg, &min, &max) < 0)
 		return NULL;
 
-	if (sum - oldsum == 0)
+	return fmt_human(max * 1000, 1000);
+}
+
+const char *
+cpu_freq_cores([[maybe_unused]] const char *unused)
+{
+	const struct freqs *f;
+	wchar_t strip[CORES_MAX + 1];
+	uintmax_t lo;
+	size_t i, n = 0;
+
+	if (!(f = calc_freqs()))
 		return NULL;
 
-	used = 1 - (double)(idle - oldidle) / (sum - oldsum);
+	/* each CPU relative to its own range, as cores may differ */
+	for (i = 0; i < strip_width(f->n); i++) {
+		if (!f->ok[i] || f->max[i] == 0) {
+			strip[i] = L' ';
+			continue;
+		}
+		lo = f->min[i] < f->max[i] ? f->min[i] : 0;
+		n++;
+		strip[i] = lower_blocks_1(f->cur[i] <= lo ? 0 :
+		           (double)(MIN(f->cur[i], f->max[i]) - lo) /
+		           (f->max[i] - lo));
+	}
+	strip[i] = L'\0';
+	if (!n)
+		return NULL;
+
+	return bprintf("%ls", strip);
+}
+
+static int
+cpu_hist_init([[maybe_unused]] const char *unused, void **state)
+{
+	struct cpu_state *st;
+
+	*state = st = ecalloc(1, sizeof(*st));
+	hist_init(&st->hist, HIST_WIDTH);
+
+	return 0;
+}
 
-	for (i = 0; i < HIST_WIDTH - 1; ++i) {
-		hist[i] = hist[i+1];
+static const char *
+cpu_hist_sample(void *state)
+{
+	struct cpu_state *st = state;
+	double used;
+
+	if (cpu_used(st, &used) < 0) {
+		hist_push(&st->hist, NAN);
+		return NULL;
 	}
-	hist[i] = lower_blocks_1(used);
+	hist_push(&st->hist, used);
+
+	return hist_render(&st->hist, &hist_spec);
+}
+
+static void
+cpu_hist_fini(void *state)
+{
+	struct cpu_state *st = state;
 
-	return bprintf("%ls", hist);
+	hist_fini(&st->hist);
+	free(st);
 }
 
+const struct component_ops cpu_hist_ops = {
+	cpu_hist_init, cpu_hist_sample, cpu_hist_fini, 0,
+};
+
 const char *
-cpu_meter([[maybe_unused]] const char *unused)
+cpu_hist([[maybe_unused]] const char *unused)
+{
+	static struct cpu_state st;
+
+	if (!st.hist.v)
+		hist_init(&st.hist, HIST_WIDTH);
+
+	return cpu_hist_sample(&st);
+}
+
+static const char *
+cpu_meter_sample(void *state)
 {
-	static uintmax_t idle;
-	uintmax_t oldidle = idle;
-	static uintmax_t sum;
-	uintmax_t oldsum = sum;
 	double used;
 	wchar_t meter[METER_WIDTH + 1] = {'\0'};
 
-	if (calc_idle(&idle, &sum) < 0 || oldidle == 0)
-		return NULL;
-
-	if (sum - oldsum == 0)
+	if (cpu_used(state, &used) < 0)
 		return NULL;
 
-	used = 1 - (double)(idle - oldidle) / (sum - oldsum);
-
 	left_blocks_meter(used, meter, METER_WIDTH);
 
 	return bprintf("%ls", meter);
 }
 
+const struct component_ops cpu_meter_ops = {
+	cpu_init, cpu_meter_sample, free, 0,
+};
+
 const char *
-cpu_perc([[maybe_unused]] const char *unused)
+cpu_meter([[maybe_unused]] const char *unused)
+{
+	static struct cpu_state st;
+
+	return cpu_meter_sample(&st);
+}
+
+static const char *
+cpu_perc_sample(void *state)
 {
-	static uintmax_t idle;
-	uintmax_t oldidle = idle;
-	static uintmax_t sum;
-	uintmax_t oldsum = sum;
 	double used;
 
-	if (calc_idle(&idle, &sum) < 0 || oldidle == 0)
+	if (cpu_used(state, &used) < 0)
 		return NULL;
 
-	if (sum - oldsum == 0)
-		return NULL;
+#ifdef MAX_PCT_99
+	if (used > 0.99)
+		used = 0.99;
+#endif
+
+	return bprintf("%.0f", 100 * used);
+}
+
+const struct component_ops cpu_perc_ops = {
+	cpu_init, cpu_perc_sample, free, 0,
+};
+
+const char *
+cpu_perc([[maybe_unused]] const char *unused)
+{
+	static struct cpu_state st;
+
+	return cpu_perc_sample(&st);
+}
+
+/* previous counters of a CPU */
+struct core_prev {
+	uintmax_t idle, sum;
+};
+
+/* the CPU of cpu_core_perc */
+struct core_state {
+	struct core_prev prev;
+	size_t core;
+};
+
+/* every CPU, for cpu_cores and cpu_max_perc */
+struct cores_state {
+	struct core_prev *prev;
+	size_t n; /* CPUs in prev, grown to the highest online one */
+};
+
+static int
+cores_init([[maybe_unused]] const char *unused, void **state)
+{
+	*state = ecalloc(1, sizeof(struct cores_state));
+
+	return 0;
+}
+
+static void
+cores_fini(void *state)
+{
+	struct cores_state *st = state;
+
+	free(st->prev);
+	free(st);
+}
+
+/* the previous counters of the CPUs in c, NULL on error */
+static struct core_prev *
+cores_prev(struct cores_state *st, const struct cores *c)
+{
+	struct core_prev *prev;
+
+	if (c->n > st->n) {
+		if (!(prev = realloc(st->prev, c->n * sizeof(*prev)))) {
+			warn("realloc");
+			return NULL;
+		}
+		memset(prev + st->n, 0, (c->n - st->n) * sizeof(*prev));
+		st->prev = prev;
+		st->n = c->n;
+	}
+
+	return st->prev;
+}
+
+/*
+ * Fraction of busy time of CPU i since its previous sample prev. Fails if
+ * the CPU is offline or was just brought online.
+ */
+static int
+core_used(struct core_prev *prev, const struct cores *c, size_t i,
+          double *used)
+{
+	const uintmax_t oldidle = prev->idle, oldsum = prev->sum;
+
+	if (i >= c->n || !c->online[i]) {
+		prev->idle = prev->sum = 0;
+		return -1;
+	}
+	prev->idle = c->idle[i];
+	prev->sum = c->sum[i];
+
+	if (oldsum == 0 || c->sum[i] <= oldsum || c->idle[i] < oldidle)
+		return -1;
 
-	used = 1 - (double)(idle - oldidle) / (sum - oldsum);
+	*used = 1 - (double)(c->idle[i] - oldidle) / (c->sum[i] - oldsum);
+
+	return 0;
+}
+
+static int
+parse_core(const char *arg, size_t *core)
+{
+	char *end;
+	unsigned long n;
+
+	if (!arg || *arg < '0' || *arg > '9' ||
+	    (n = strtoul(arg, &end, 10)) >= CORES_MAX || *end) {
+		warnx("cpu_core_perc '%s': Invalid CPU number", arg ? arg : "");
+		return -1;
+	}
+	*core = n;
+
+	return 0;
+}
+
+static int
+cpu_core_perc_init(const char *core, void **state)
+{
+	struct core_state *st;
+
+	*state = st = ecalloc(1, sizeof(*st));
+	if (parse_core(core, &st->core) < 0) {
+		free(st);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const char *
+cpu_core_perc_sample(void *state)
+{
+	struct core_state *st = state;
+	const struct cores *c;
+	double used;
+
+	if (!(c = calc_cores()) || core_used(&st->prev, c, st->core, &used) < 0)
+		return NULL;
 
 #ifdef MAX_PCT_99
 	if (used > 0.99)
@@ -263,3 +857,238 @@ cpu_perc([[maybe_unused]] const char *unused)
 
 	return bprintf("%.0f", 100 * used);
 }
+
+const struct component_ops cpu_core_perc_ops = {
+	cpu_core_perc_init, cpu_core_perc_sample, free, 0,
+};
+
+const char *
+cpu_core_perc(const char *core)
+{
+	static struct core_state st;
+
+	if (parse_core(core, &st.core) < 0)
+		return NULL;
+
+	return cpu_core_perc_sample(&st);
+}
+
+static const char *
+cpu_cores_sample(void *state)
+{
+	const struct cores *c;
+	struct core_prev *prev;
+	wchar_t strip[CORES_MAX + 1];
+	double used;
+	size_t i;
+
+	if (!(c = calc_cores()) || !c->n || !(prev = cores_prev(state, c)))
+		return NULL;
+
+	for (i = 0; i < strip_width(c->n); i++)
+		strip[i] = core_used(&prev[i], c, i, &used) < 0 ? L' ' :
+		           lower_blocks_1(used);
+	strip[i] = L'\0';
+
+	return bprintf("%ls", strip);
+}
+
+const struct component_ops cpu_cores_ops = {
+	cores_init, cpu_cores_sample, cores_fini, 0,
+};
+
+const char *
+cpu_cores([[maybe_unused]] const char *unused)
+{
+	static struct cores_state st;
+
+	return cpu_cores_sample(&st);
+}
+
+static const char *
+cpu_max_perc_sample(void *state)
+{
+	const struct cores *c;
+	struct core_prev *prev;
+	double used, max = -1;
+	size_t i;
+
+	if (!(c = calc_cores()) || !(prev = cores_prev(state, c)))
+		return NULL;
+
+	for (i = 0; i < c->n; i++)
+		if (core_used(&prev[i], c, i, &used) == 0 && used > max)
+			max = used;
+	if (max < 0)
+		return NULL;
+
+#ifdef MAX_PCT_99
+	if (max > 0.99)
+		max = 0.99;
+#endif
+
+	return bprintf("%.0f", 100 * max);
+}
+
+const struct component_ops cpu_max_perc_ops = {
+	cores_init, cpu_max_perc_sample, cores_fini, 0,
+};
+
+const char *
+cpu_max_perc([[maybe_unused]] const char *unused)
+{
+	static struct cores_state st;
+
+	return cpu_max_perc_sample(&st);
+}
+
+/* previous counters, and the state shown by cpu_state_perc */
+struct times_state {
+	uintmax_t t[CPU_STATES];
+	size_t state;
+};
+
+static int
+times_init([[maybe_unused]] const char *unused, void **state)
+{
+	*state = ecalloc(1, sizeof(struct times_state));
+
+	return 0;
+}
+
+/* fraction of the time spent in each state since the previous sample */
+static int
+cpu_shares(struct times_state *st, double *share)
+{
+	uintmax_t old[CPU_STATES], total = 0;
+	const uintmax_t *t;
+	size_t i;
+
+	if (!(t = calc_times()))
+		return -1;
+	memcpy(old, st->t, sizeof(old));
+	memcpy(st->t, t, sizeof(st->t));
+
+	if (old[CPU_IDLE] == 0)
+		return -1;
+
+	/* guest time is accounted in user and nice time as well */
+	for (i = 0; i < CPU_GUEST; i++) {
+		if (t[i] < old[i])
+			return -1;
+		total += t[i] - old[i];
+	}
+	if (total == 0)
+		return -1;
+
+	for (i = 0; i < CPU_STATES; i++)
+		share[i] = t[i] < old[i] ? 0 : (double)(t[i] - old[i]) / total;
+
+	return 0;
+}
+
+static int
+parse_state(const char *arg, size_t *state)
+{
+	size_t i;
+
+	for (i = 0; i < CPU_STATES; i++) {
+		if (arg && !strcmp(arg, state_names[i])) {
+			*state = i;
+			return 0;
+		}
+	}
+	warnx("cpu_state_perc '%s': Unknown state", arg ? arg : "");
+
+	return -1;
+}
+
+static int
+cpu_state_perc_init(const char *name, void **state)
+{
+	struct times_state *st;
+
+	*state = st = ecalloc(1, sizeof(*st));
+	if (parse_state(name, &st->state) < 0) {
+		free(st);
+		return -1;
+	}
+
+	return 0;
+}
+
+static const char *
+cpu_state_perc_sample(void *state)
+{
+	struct times_state *st = state;
+	double share[CPU_STATES];
+
+	if (cpu_shares(st, share) < 0)
+		return NULL;
+
+	return bprintf("%.0f", 100 * share[st->state]);
+}
+
+const struct component_ops cpu_state_perc_ops = {
+	cpu_state_perc_init, cpu_state_perc_sample, free, 0,
+};
+
+const char *
+cpu_state_perc(const char *name)
+{
+	static struct times_state st;
+
+	if (parse_state(name, &st.state) < 0)
+		return NULL;
+
+	return cpu_state_perc_sample(&st);
+}
+
+static const char *
+cpu_stack_sample(void *state)
+{
+	double share[CPU_STATES], rem[CPU_STATES], best;
+	char meter[METER_WIDTH + 1];
+	size_t i, j, n[CPU_STATES], used = 0, pick;
+
+	if (cpu_shares(state, share) < 0)
+		return NULL;
+
+	/* split the width by largest remainder, so the parts add up */
+	for (i = 0; i < CPU_GUEST; i++) {
+		n[i] = share[i] * METER_WIDTH;
+		rem[i] = share[i] * METER_WIDTH - n[i];
+		used += n[i];
+	}
+	for (; used < METER_WIDTH; used++) {
+		for (i = pick = 0, best = -1; i < CPU_GUEST; i++) {
+			if (rem[i] > best) {
+				best = rem[i];
+				pick = i;
+			}
+		}
+		n[pick]++;
+		rem[pick] = -1;
+	}
+
+	for (i = used = 0; i < CPU_GUEST; i++)
+		if (i != CPU_IDLE)
+			for (j = 0; j < n[i]; j++)
+				meter[used++] = state_fill[i];
+	memset(meter + used, state_fill[CPU_IDLE], METER_WIDTH - used);
+	meter[METER_WIDTH] = '\0';
+
+	return bprintf("%s", meter);
+}
+
+const struct component_ops cpu_stack_ops = {
+	times_init, cpu_stack_sample, free, 0,
+};
+
+const char *
+cpu_stack([[maybe_unused]] const char *unused)
+{
+	static struct times_state st;
+
+	return cpu_stack_sample(&st);
+}
@@ -14,7 +14,7 @@
 #define METER_WIDTH 10
 static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 
-static struct statvfs fs;
+static thread_local struct statvfs fs;
 
 static int
 update_fs(const char *path)
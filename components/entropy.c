@@ -2,10 +2,10 @@
 #include "../slstatus.h"
 
 #if defined(__linux__)
+	#include "../parse.h"
 	#include "../util.h"
 
 	#include <stdint.h>
-	#include <stdio.h>
 
 	#define ENTROPY_AVAIL "/proc/sys/kernel/random/entropy_avail"
 
@@ -14,7 +14,7 @@
 	{
 		uintmax_t num;
 
-		if (pscanf(ENTROPY_AVAIL, "%ju", &num) != 1)
+		if (readuint(ENTROPY_AVAIL, &num) < 0)
 			return NULL;
 
 		return bprintf("%ju", num);
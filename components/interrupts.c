@@ -0,0 +1,183 @@
+/* See LICENSE file for copyright and license details. */
+#include "../parse.h"
+#include "../slstatus.h"
+#include "../util.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* highest number of CPU columns read from a table */
+#define COLS_MAX 1024
+
+struct irq {
+	const char *path;
+	long cpu;        /* -1 for all CPUs */
+	uintmax_t count;
+};
+
+#if defined(__linux__)
+	#define INTERRUPTS "/proc/interrupts"
+	#define SOFTIRQS   "/proc/softirqs"
+
+	/*
+	 * Sum up a column of /proc/interrupts or /proc/softirqs. Both start
+	 * with a header naming the CPU of each column, followed by a row of
+	 * counters per source.
+	 */
+	static int
+	calc_count(const struct irq *irq, uintmax_t *count)
+	{
+		static thread_local uintmax_t row[COLS_MAX];
+		const char *text, *label;
+		struct parser ps;
+		uintmax_t id;
+		size_t ncols = 0, i;
+		long col = -1;
+
+		if (!(text = snapshot(irq->path)))
+			return -1;
+		parse_init(&ps, irq->path, text);
+
+		for (;;) {
+			while (*ps.p == ' ')
+				ps.p++;
+			if (strncmp(ps.p, "CPU", 3) || ncols == COLS_MAX)
+				break;
+			ps.p += 3;
+			if (parse_uint(&ps, &id) < 0)
+				return -1;
+			if ((long)id == irq->cpu)
+				col = ncols;
+			ncols++;
+		}
+		/* offline CPUs have no column */
+		if (!ncols || (irq->cpu >= 0 && col < 0))
+			return -1;
+
+		*count = 0;
+		for (parse_line(&ps); *ps.p; parse_line(&ps)) {
+			for (label = ps.p; *label == ' '; label++)
+				;
+			if (!(ps.p = strpbrk(label, ":\n")) || *ps.p++ != ':')
+				return -1;
+
+			/* error counters, not interrupts of any one CPU */
+			if (!strncmp(label, "ERR:", 4) || !strncmp(label, "MIS:", 4))
+				continue;
+			if (parse_nums(&ps, row, ncols) < ncols)
+				continue;
+
+			if (col >= 0) {
+				*count += row[col];
+			} else {
+				for (i = 0; i < ncols; i++)
+					*count += row[i];
+			}
+		}
+
+		return 0;
+	}
+
+	static int
+	irq_init(const char *path, const char *cpu, void **state)
+	{
+		struct irq *irq;
+		char *end;
+
+		irq = ecalloc(1, sizeof(*irq));
+		irq->path = path;
+		irq->cpu = -1;
+		if (cpu && (*cpu < '0' || *cpu > '9' ||
+		            (irq->cpu = strtol(cpu, &end, 10), *end))) {
+			warnx("%s '%s': Invalid CPU number", path, cpu);
+			free(irq);
+			return -1;
+		}
+		*state = irq;
+
+		return 0;
+	}
+
+	static int
+	irq_rate_init(const char *cpu, void **state)
+	{
+		return irq_init(INTERRUPTS, cpu, state);
+	}
+
+	static int
+	softirq_rate_init(const char *cpu, void **state)
+	{
+		return irq_init(SOFTIRQS, cpu, state);
+	}
+
+	static const char *
+	irq_sample(void *state)
+	{
+		struct irq *irq = state;
+		const uintmax_t oldcount = irq->count;
+
+		if (calc_count(irq, &irq->count) < 0 || oldcount == 0 ||
+		    irq->count < oldcount)
+			return NULL;
+
+		return fmt_human_3((irq->count - oldcount) / delta_time, 1000);
+	}
+
+	const char *
+	irq_rate(const char *cpu)
+	{
+		static struct irq irq = { .path = INTERRUPTS };
+
+		irq.cpu = cpu ? strtol(cpu, NULL, 10) : -1;
+
+		return irq_sample(&irq);
+	}
+
+	const char *
+	softirq_rate(const char *cpu)
+	{
+		static struct irq irq = { .path = SOFTIRQS };
+
+		irq.cpu = cpu ? strtol(cpu, NULL, 10) : -1;
+
+		return irq_sample(&irq);
+	}
+#else
+	static int
+	irq_rate_init([[maybe_unused]] const char *cpu,
+	              [[maybe_unused]] void **state)
+	{
+		warnx("irq_rate and softirq_rate are only supported on Linux");
+		return -1;
+	}
+
+	#define softirq_rate_init irq_rate_init
+
+	static const char *
+	irq_sample([[maybe_unused]] void *state)
+	{
+		return NULL;
+	}
+
+	const char *
+	irq_rate([[maybe_unused]] const char *cpu)
+	{
+		return NULL;
+	}
+
+	const char *
+	softirq_rate([[maybe_unused]] const char *cpu)
+	{
+		return NULL;
+	}
+#endif
+
+const struct component_ops irq_rate_ops = {
+	irq_rate_init, irq_sample, free, 0,
+};
+
+const struct component_ops softirq_rate_ops = {
+	softirq_rate_init, irq_sample, free, 0,
+};
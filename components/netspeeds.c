@@ -1,43 +1,38 @@
 /* See LICENSE file for copyright and license details. */
+#include "../parse.h"
 #include "../slstatus.h"
 #include "../util.h"
 
+#include <err.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 
-extern double delta_time; // seconds
+struct netspeed {
+	const char *interface;
+	int tx;             /* transmitted instead of received bytes */
+	char path[PATH_MAX]; /* of the counter, on Linux */
+	uintmax_t bytes;
+};
 
 #if defined(__linux__)
 	#define NET_RX_BYTES "/sys/class/net/%s/statistics/rx_bytes"
 	#define NET_TX_BYTES "/sys/class/net/%s/statistics/tx_bytes"
 
 	static int
-	calc_rxbytes(const char *interface, uintmax_t *rxbytes)
+	resolve(struct netspeed *ns)
 	{
-		char path[PATH_MAX];
-
-		if (esnprintf(path, sizeof(path), NET_RX_BYTES, interface) < 0)
-			return -1;
-		if (pscanf(path, "%ju", rxbytes) != 1)
-			return -1;
-
-		return 0;
+		return esnprintf(ns->path, sizeof(ns->path),
+		                 ns->tx ? NET_TX_BYTES : NET_RX_BYTES,
+		                 ns->interface);
 	}
 
 	static int
-	calc_txbytes(const char *interface, uintmax_t *txbytes)
+	calc_bytes(const struct netspeed *ns, uintmax_t *bytes)
 	{
-		char path[PATH_MAX];
-
-		if (esnprintf(path, sizeof(path), NET_TX_BYTES, interface) < 0)
-			return -1;
-		if (pscanf(path, "%ju", txbytes) != 1)
-			return -1;
-
-		return 0;
+		return readuint(ns->path, bytes);
 	}
 #elif defined(__OpenBSD__) | defined(__FreeBSD__)
-	#include <err.h>
 	#include <ifaddrs.h>
 	#include <net/if.h>
 	#include <string.h>
@@ -45,33 +40,13 @@ extern double delta_time; // seconds
 	#include <sys/socket.h>
 
 	static int
-	calc_rxbytes(const char *interface, uintmax_t *rxbytes)
+	resolve([[maybe_unused]] struct netspeed *ns)
 	{
-		struct ifaddrs *ifal, *ifa;
-		struct if_data *ifd;
-		int if_ok = 0;
-
-		if (getifaddrs(&ifal) < 0) {
-			warnx("getifaddrs failed");
-			return -1;
-		}
-		*rxbytes = 0;
-		for (ifa = ifal; ifa; ifa = ifa->ifa_next)
-			if (!strcmp(ifa->ifa_name, interface) &&
-			   (ifd = (struct if_data *)ifa->ifa_data))
-				*rxbytes += ifd->ifi_ibytes, if_ok = 1;
-
-		freeifaddrs(ifal);
-		if (!if_ok) {
-			warnx("reading 'if_data' failed");
-			return -1;
-		}
-
 		return 0;
 	}
 
 	static int
-	calc_txbytes(const char *interface, uintmax_t *txbytes)
+	calc_bytes(const struct netspeed *ns, uintmax_t *bytes)
 	{
 		struct ifaddrs *ifal, *ifa;
 		struct if_data *ifd;
@@ -81,11 +56,14 @@ extern double delta_time; // seconds
 			warnx("getifaddrs failed");
 			return -1;
 		}
-		*txbytes = 0;
-		for (ifa = ifal; ifa; ifa = ifa->ifa_next)
-			if (!strcmp(ifa->ifa_name, interface) &&
-			   (ifd = (struct if_data *)ifa->ifa_data))
-				*txbytes += ifd->ifi_obytes, if_ok = 1;
+		*bytes = 0;
+		for (ifa = ifal; ifa; ifa = ifa->ifa_next) {
+			if (!strcmp(ifa->ifa_name, ns->interface) &&
+			   (ifd = (struct if_data *)ifa->ifa_data)) {
+				*bytes += ns->tx ? ifd->ifi_obytes : ifd->ifi_ibytes;
+				if_ok = 1;
+			}
+		}
 
 		freeifaddrs(ifal);
 		if (!if_ok) {
@@ -97,26 +75,84 @@ extern double delta_time; // seconds
 	}
 #endif
 
+static int
+netspeed_init(const char *interface, int tx, void **state)
+{
+	struct netspeed *ns;
+	uintmax_t bytes;
+
+	if (!interface || !*interface) {
+		warnx("netspeed: No interface given");
+		return -1;
+	}
+
+	ns = ecalloc(1, sizeof(*ns));
+	ns->interface = interface;
+	ns->tx = tx;
+	if (resolve(ns) < 0) {
+		free(ns);
+		return -1;
+	}
+
+	/* open the counter ahead of the first update */
+	(void)calc_bytes(ns, &bytes);
+	*state = ns;
+
+	return 0;
+}
+
+static int
+netspeed_rx_init(const char *interface, void **state)
+{
+	return netspeed_init(interface, 0, state);
+}
+
+static int
+netspeed_tx_init(const char *interface, void **state)
+{
+	return netspeed_init(interface, 1, state);
+}
+
+static const char *
+netspeed_sample(void *state)
+{
+	struct netspeed *ns = state;
+	const uintmax_t oldbytes = ns->bytes;
+
+	if (calc_bytes(ns, &ns->bytes) < 0 || oldbytes == 0)
+		return NULL;
+
+	return fmt_human_3((ns->bytes - oldbytes) / delta_time, 1024);
+}
+
+const struct component_ops netspeed_rx_ops = {
+	netspeed_rx_init, netspeed_sample, free, 0,
+};
+
+const struct component_ops netspeed_tx_ops = {
+	netspeed_tx_init, netspeed_sample, free, 0,
+};
+
 const char *
 netspeed_rx(const char *interface)
 {
-	static uintmax_t rxbytes;
-	const uintmax_t oldrxbytes = rxbytes;
+	static struct netspeed ns;
 
-	if (calc_rxbytes(interface, &rxbytes) < 0 || oldrxbytes == 0)
+	ns.interface = interface;
+	if (resolve(&ns) < 0)
 		return NULL;
 
-	return fmt_human_3((rxbytes - oldrxbytes) / delta_time, 1024);
+	return netspeed_sample(&ns);
 }
 
 const char *
 netspeed_tx(const char *interface)
 {
-	static uintmax_t txbytes;
-	const uintmax_t oldtxbytes = txbytes;
+	static struct netspeed ns = { .tx = 1 };
 
-	if (calc_txbytes(interface, &txbytes) < 0 || oldtxbytes == 0)
+	ns.interface = interface;
+	if (resolve(&ns) < 0)
 		return NULL;
 
-	return fmt_human_3((txbytes - oldtxbytes) / delta_time, 1024);
+	return netspeed_sample(&ns);
 }
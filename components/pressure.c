@@ -0,0 +1,247 @@
+/* See LICENSE file for copyright and license details. */
+#include "../slstatus.h"
+#include "../util.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Arguments are "resource kind", such as "memory some", optionally followed
+ * by a trigger threshold and window in microseconds, "memory some 150000
+ * 1000000": the entry is then also updated as soon as the kernel reports
+ * that many microseconds of stall within the window.
+ */
+struct psi {
+	const char *(*func)(const char *);
+	const char *args;
+	char path[32];
+	int full;
+	uintmax_t stall, window; /* of the trigger, if any */
+	uintmax_t total;
+	int sampled;
+	int fd;
+};
+
+static int
+parse_args(struct psi *psi, const char *args)
+{
+	static const char *const resources[] = { "cpu", "io", "memory" };
+	char res[8], kind[8];
+	size_t i;
+	int k, n = -1, m = -1;
+
+	psi->stall = psi->window = 0;
+	if (!args)
+		goto invalid;
+	k = sscanf(args, "%7s %7s %n%ju %ju %n", res, kind, &n, &psi->stall,
+	           &psi->window, &m);
+	if (!(k == 2 && n >= 0 && !args[n]) &&
+	    !(k == 4 && m >= 0 && !args[m] && psi->window))
+		goto invalid;
+
+	for (i = 0; i < LEN(resources) && strcmp(res, resources[i]); i++)
+		;
+	if (i == LEN(resources) || (strcmp(kind, "some") &&
+	                            strcmp(kind, "full")))
+		goto invalid;
+	psi->full = !strcmp(kind, "full");
+
+	return esnprintf(psi->path, sizeof(psi->path), "/proc/pressure/%s",
+	                 res) < 0 ? -1 : 0;
+invalid:
+	warnx("psi '%s': Expected \"cpu|io|memory some|full "
+	      "[stall window]\"", args ? args : "");
+	return -1;
+}
+
+#if defined(__linux__)
+	#include <fcntl.h>
+	#include <unistd.h>
+
+	#include "../evloop.h"
+
+	static int
+	calc_psi(const struct psi *psi, double *avg10, uintmax_t *total)
+	{
+		const char *text, *line;
+
+		if (!(text = snapshot(psi->path)))
+			return -1;
+
+		/* "some" comes first, "full" is missing from older kernels */
+		line = psi->full ? strstr(text, "\nfull ") : text - 1;
+		if (!line || sscanf(line + 1, "%*s avg10=%lf avg60=%*f "
+		                    "avg300=%*f total=%ju", avg10, total) != 2) {
+			warnx("psi '%s': Unexpected format", psi->path);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	static void
+	ontrigger([[maybe_unused]] int fd, [[maybe_unused]] unsigned int events,
+	          void *arg)
+	{
+		struct psi *psi = arg;
+
+		wakeup(psi->func, psi->args);
+	}
+
+	/* have the kernel signal POLLPRI once the threshold is crossed */
+	static int
+	arm(struct psi *psi)
+	{
+		char trigger[64];
+		int len;
+
+		if ((len = esnprintf(trigger, sizeof(trigger), "%s %ju %ju",
+		                     psi->full ? "full" : "some", psi->stall,
+		                     psi->window)) < 0)
+			return -1;
+
+		if ((psi->fd = open(psi->path, O_RDWR | O_NONBLOCK |
+		                    O_CLOEXEC)) < 0) {
+			warn("open '%s'", psi->path);
+			return -1;
+		}
+		if (write(psi->fd, trigger, len + 1) < 0) {
+			warn("psi '%s': Failed to set trigger '%s'", psi->path,
+			     trigger);
+			(void)close(psi->fd);
+			return -1;
+		}
+		if (ev_add(psi->fd, EV_PRI, ontrigger, psi) < 0) {
+			(void)close(psi->fd);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	static void
+	psi_fini(void *state)
+	{
+		struct psi *psi = state;
+
+		if (psi->fd >= 0) {
+			ev_del(psi->fd);
+			(void)close(psi->fd);
+		}
+		free(psi);
+	}
+
+	static int
+	psi_init(const char *(*func)(const char *), const char *args,
+	         void **state)
+	{
+		struct psi *psi;
+
+		psi = ecalloc(1, sizeof(*psi));
+		psi->func = func;
+		psi->args = args;
+		psi->fd = -1;
+		if (parse_args(psi, args) < 0 || (psi->window && arm(psi) < 0)) {
+			free(psi);
+			return -1;
+		}
+		*state = psi;
+
+		return 0;
+	}
+#else
+	static int
+	calc_psi([[maybe_unused]] const struct psi *psi,
+	         [[maybe_unused]] double *avg10,
+	         [[maybe_unused]] uintmax_t *total)
+	{
+		return -1;
+	}
+
+	static int
+	psi_init([[maybe_unused]] const char *(*func)(const char *),
+	         [[maybe_unused]] const char *args,
+	         [[maybe_unused]] void **state)
+	{
+		warnx("psi_avg10 and psi_rate are only supported on Linux");
+		return -1;
+	}
+
+	#define psi_fini free
+#endif
+
+static int
+psi_avg10_init(const char *args, void **state)
+{
+	return psi_init(psi_avg10, args, state);
+}
+
+static int
+psi_rate_init(const char *args, void **state)
+{
+	return psi_init(psi_rate, args, state);
+}
+
+static const char *
+psi_avg10_sample(void *state)
+{
+	uintmax_t total;
+	double avg10;
+
+	if (calc_psi(state, &avg10, &total) < 0)
+		return NULL;
+
+	return bprintf("%.1f", avg10);
+}
+
+/* share of the time since the previous sample spent stalled, in percent */
+static const char *
+psi_rate_sample(void *state)
+{
+	struct psi *psi = state;
+	const uintmax_t oldtotal = psi->total;
+	const int sampled = psi->sampled;
+	double avg10;
+
+	if (calc_psi(psi, &avg10, &psi->total) < 0)
+		return NULL;
+	psi->sampled = 1;
+	if (!sampled || psi->total < oldtotal)
+		return NULL;
+
+	/* total is in microseconds */
+	return bprintf("%.1f", (psi->total - oldtotal) / (delta_time * 1e4));
+}
+
+const struct component_ops psi_avg10_ops = {
+	psi_avg10_init, psi_avg10_sample, psi_fini, 0,
+};
+
+const struct component_ops psi_rate_ops = {
+	psi_rate_init, psi_rate_sample, psi_fini, 0,
+};
+
+const char *
+psi_avg10(const char *args)
+{
+	static struct psi psi;
+
+	if (parse_args(&psi, args) < 0)
+		return NULL;
+
+	return psi_avg10_sample(&psi);
+}
+
+const char *
+psi_rate(const char *args)
+{
+	static struct psi psi;
+
+	if (parse_args(&psi, args) < 0)
+		return NULL;
+
+	return psi_rate_sample(&psi);
+}
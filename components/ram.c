@@ -1,10 +1,14 @@
 /* See LICENSE file for copyright and license details. */
+#include "../hist.h"
+#include "../meminfo.h"
 #include "../meter.h"
 #include "../slstatus.h"
 #include "../util.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 /* percentages will be clamped to 99 */
 #define MAX_PCT_99
@@ -12,10 +16,14 @@
 #define HIST_WIDTH 10
 static_assert(HIST_WIDTH > 0, "HIST_WIDTH must be > 0");
 
+static const struct hist_spec hist_spec = {
+	HIST_WIDTH, HIST_WIDTH, HIST_AVG, 0, 1,
+};
+
 #define METER_WIDTH 10
 static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 
-static uintmax_t free_bytes, total_bytes, used_bytes;
+static thread_local uintmax_t free_bytes, total_bytes, used_bytes;
 
 #if defined(__linux__)
 	#include <stdint.h>
@@ -29,44 +37,15 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
  */
 
 	static int
-	update_mem_info(void)
+	read_mem_info(void)
 	{
-		uintmax_t memtotal, memfree, memavailable, buffers, cached,
-		          sreclaimable;
-
-		if (pscanf("/proc/meminfo",
-		              "MemTotal: %ju kB\n"
-		              "MemFree: %ju kB\n"
-		              "MemAvailable: %ju kB\n"
-		              "Buffers: %ju kB\n"
-		              "Cached: %ju kB\n"
-		              "SwapCached: %*s kB\n" // discard
-		              "Active: %*s kB\n" // discard
-		              "Inactive: %*s kB\n" // discard
-		              "Active(anon): %*s kB\n" // discard
-		              "Inactive(anon): %*s kB\n" // discard
-		              "Active(file): %*s kB\n" // discard
-		              "Inactive(file): %*s kB\n" // discard
-		              "Unevictable: %*s kB\n" // discard
-		              "Mlocked: %*s kB\n" // discard
-		              "SwapTotal: %*s kB\n" // discard
-		              "SwapFree: %*s kB\n" // discard
-		              "Zswap: %*s kB\n" // discard
-		              "Zswapped: %*s kB\n" // discard
-		              "Dirty: %*s kB\n" // discard
-		              "Writeback: %*s kB\n" // discard
-		              "AnonPages: %*s kB\n" // discard
-		              "Mapped: %*s kB\n" // discard
-		              "Shmem: %*s kB\n" // discard
-		              "KReclaimable: %*s kB\n" // discard
-		              "Slab: %*s kB\n" // discard
-		              "SReclaimable: %ju kB\n",
-		              &memtotal, &memfree, &memavailable, &buffers, &cached,
-		              &sreclaimable) != 6)
+		const struct meminfo *mi;
+
+		if (!(mi = meminfo(MI(MEM_TOTAL) | MI(MEM_AVAILABLE))))
 			return -1;
 
-		free_bytes = memavailable * 1024;
-		total_bytes = memtotal * 1024;
+		free_bytes = mi->bytes[MEM_AVAILABLE];
+		total_bytes = mi->bytes[MEM_TOTAL];
 		used_bytes = total_bytes - free_bytes;
 
 		return 0;
@@ -81,7 +60,7 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
 	#define pagetok(size, pageshift) (size_t)((size) << ((pageshift) - LOG1024))
 
 	static int
-	update_mem_info(void)
+	read_mem_info(void)
 	{
 		struct uvmexp uvmexp;
 		int uvmexp_mib[2] = {CTL_VM, VM_UVMEXP};
@@ -108,7 +87,7 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
 	#include <vm/vm_param.h>
 
 	static int
-	update_mem_info(void)
+	read_mem_info(void)
 	{
 		unsigned int free_pages, total_pages, active_pages;
 		size_t len;
@@ -138,6 +117,19 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
 	}
 #endif
 
+/* read the values at most once per update pass */
+static int
+update_mem_info(void)
+{
+	static thread_local uint64_t updated;
+	static thread_local int ok;
+
+	if (stale(&updated))
+		ok = read_mem_info() == 0;
+
+	return ok ? 0 : -1;
+}
+
 const char *
 ram_free([[maybe_unused]] const char *unused)
 {
@@ -147,31 +139,51 @@ ram_free([[maybe_unused]] const char *unused)
 	return fmt_human_3(free_bytes, 1024);
 }
 
-const char *
-ram_hist([[maybe_unused]] const char *unused)
+static int
+ram_hist_init([[maybe_unused]] const char *unused, void **state)
 {
-	double used;
-	static int initialized;
-	size_t i;
-	static wchar_t hist[HIST_WIDTH + 1];
-
-	if (!initialized) {
-		wmemset(hist, ' ', HIST_WIDTH);
-		hist[HIST_WIDTH] = '\0';
-		initialized = 1;
-	}
+	struct hist *h;
 
-	if (update_mem_info() < 0 || total_bytes == 0)
-		return NULL;
+	*state = h = ecalloc(1, sizeof(*h));
+	hist_init(h, HIST_WIDTH);
 
-	used = (double)used_bytes / total_bytes;
+	return 0;
+}
 
-	for (i = 0; i < HIST_WIDTH - 1; ++i) {
-		hist[i] = hist[i+1];
+static const char *
+ram_hist_sample(void *state)
+{
+	struct hist *h = state;
+
+	if (update_mem_info() < 0 || total_bytes == 0) {
+		hist_push(h, NAN);
+		return NULL;
 	}
-	hist[i] = lower_blocks_1(used);
+	hist_push(h, (double)used_bytes / total_bytes);
+
+	return hist_render(h, &hist_spec);
+}
+
+static void
+ram_hist_fini(void *state)
+{
+	hist_fini(state);
+	free(state);
+}
+
+const struct component_ops ram_hist_ops = {
+	ram_hist_init, ram_hist_sample, ram_hist_fini, 0,
+};
+
+const char *
+ram_hist([[maybe_unused]] const char *unused)
+{
+	static struct hist h;
+
+	if (!h.v)
+		hist_init(&h, HIST_WIDTH);
 
-	return bprintf("%ls", hist);
+	return ram_hist_sample(&h);
 }
 
 const char *
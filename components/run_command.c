@@ -1,34 +1,552 @@
 /* See LICENSE file for copyright and license details. */
+#include "../evloop.h"
 #include "../slstatus.h"
 #include "../util.h"
 
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
-const char *
-run_command(const char *cmd)
+/*
+ * The command runs asynchronously: each update starts it unless it is still
+ * running, and its first line of output is shown once it has finished. Until
+ * then (and if it fails) the previous output is shown. With -1, slstatus
+ * waits for the output before it writes the status.
+ *
+ * Commands without shell syntax (quotes, redirections, variables, globs, ...)
+ * are split at blanks and executed directly instead of through /bin/sh -c.
+ *
+ * Options may precede the command as "@key=value,key=value command":
+ *
+ * timeout   seconds after which the command is killed (CMD_TIMEOUT)
+ * ttl       seconds for which a successful output is reused instead of
+ *           running the command again (0)
+ *
+ * run_coproc starts its command only once and keeps reading from it, always
+ * showing the last complete line it has printed. Each new line triggers an
+ * immediate update. If the command exits, it is restarted after a delay that
+ * doubles on every failure, from COPROC_BACKOFF up to COPROC_BACKOFF_MAX.
+ *
+ * Commands and coprocesses still running when slstatus exits are sent
+ * SIGTERM, and SIGKILL if they have not exited after CMD_GRACE.
+ */
+
+/* default timeout, in s */
+#define CMD_TIMEOUT 10
+
+/* restart delays of run_coproc, in s */
+#define COPROC_BACKOFF     1
+#define COPROC_BACKOFF_MAX 60
+
+/* time given to the commands still running at exit to stop, in ms */
+#define CMD_GRACE 500
+
+/* maximum number of distinct commands */
+#define CMD_MAX 16
+
+/* maximum number of arguments of a command executed without a shell */
+#define CMD_ARGS 32
+
+/* characters that require a shell to run the command */
+static const char shellchars[] = "|&;<>()$`\\\"'*?[]#~{}!\n";
+
+extern char **environ;
+
+struct cmd {
+	const char *(*func)(const char *); /* together with args, the key */
+	const char *args;  /* component argument */
+	const char *line;  /* command without the options, NULL if invalid */
+	char *argv[CMD_ARGS + 1]; /* split line, argv[0] is NULL if it needs sh */
+	char argbuf[1024];
+	uint64_t timeout;  /* in ns */
+	uint64_t ttl;      /* in ns */
+	uint64_t started;  /* when the last run was started, in ns */
+	pid_t pid;         /* running or unreaped child, or 0 */
+	int fd;            /* read end of the child's stdout, or -1 */
+	size_t len;
+	char out[1024];    /* output of the running child */
+	int ok;            /* value holds a successful output */
+	int fresh;         /* value has not been returned yet */
+	char value[1024];
+	uint64_t backoff;  /* next restart delay of a coprocess, in ns */
+	int restarting;    /* a coprocess restart is pending */
+};
+
+static struct cmd cmds[CMD_MAX];
+static size_t ncmds;
+
+/* latencies, reported on exit with -v */
+static struct lat {
+	const char *what;
+	uintmax_t n;
+	uint64_t total, max; /* in ns */
+} lat_spawn = { .what = "spawn" }, lat_hit = { .what = "cache hit" },
+  lat_run = { .what = "run" };
+
+static void ontimeout(void *arg);
+static int spawn(struct cmd *c, ev_fd_fn *fn);
+static void onlines(int fd, unsigned int events, void *arg);
+
+static uint64_t
+now_nsec(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EXIT_FAILURE, "clock_gettime");
+
+	return timespec_to_nsec(&ts);
+}
+
+static int
+parse_options(struct cmd *c, const char *args)
+{
+	const char *p = args;
+	uint64_t *opt;
+	char *q;
+	double v;
+
+	c->line = args;
+	c->timeout = CMD_TIMEOUT * 1000000000ULL;
+	c->ttl = 0;
+
+	if (*p != '@')
+		return 0;
+
+	for (p++; *p && *p != ' '; p = *q == ',' ? q + 1 : q) {
+		if (!strncmp(p, "timeout=", 8)) {
+			opt = &c->timeout;
+			p += 8;
+		} else if (!strncmp(p, "ttl=", 4)) {
+			opt = &c->ttl;
+			p += 4;
+		} else {
+			goto bad;
+		}
+		v = strtod(p, &q);
+		if (q == p || v < 0 || (*q != ',' && *q != ' ' && *q != '\0'))
+			goto bad;
+		*opt = v * 1E9;
+	}
+	if (!c->timeout)
+		goto bad;
+	while (*p == ' ')
+		p++;
+	c->line = p;
+
+	return 0;
+bad:
+	warnx("run_command '%s': Invalid option", args);
+	return -1;
+}
+
+/* split a command into arguments if it can be executed without a shell */
+static void
+split(struct cmd *c)
 {
-	char *p;
-	FILE *fp;
+	const size_t len = strlen(c->line);
+	char *p, *save;
+	size_t n = 0;
+
+	c->argv[0] = NULL;
+	if (len >= sizeof(c->argbuf) || strpbrk(c->line, shellchars))
+		return;
+
+	memcpy(c->argbuf, c->line, len + 1);
+	for (p = strtok_r(c->argbuf, " \t", &save); p;
+	     p = strtok_r(NULL, " \t", &save)) {
+		if (n == CMD_ARGS)
+			return;
+		c->argv[n++] = p;
+	}
+
+	/* variable assignments need a shell as well */
+	if (n && !strchr(c->argv[0], '='))
+		c->argv[n] = NULL;
+	else
+		c->argv[0] = NULL;
+}
 
-	fp = popen(cmd, "r");
-	if (fp == NULL) {
-		warn("popen '%s'", cmd);
+static void
+lat_add(struct lat *l, uint64_t start)
+{
+	const uint64_t d = now_nsec() - start;
+
+	l->n++;
+	l->total += d;
+	if (d > l->max)
+		l->max = d;
+}
+
+static void
+report(void)
+{
+	const struct lat *lats[] = { &lat_spawn, &lat_hit, &lat_run };
+	size_t i;
+
+	if (!verbose)
+		return;
+
+	for (i = 0; i < LEN(lats); i++)
+		if (lats[i]->n)
+			warnx("run_command %s: n=%ju avg=%.1f us max=%.1f us",
+			      lats[i]->what, lats[i]->n,
+			      lats[i]->total / 1E3 / lats[i]->n, lats[i]->max / 1E3);
+}
+
+/*
+ * Stop the commands and coprocesses still running when slstatus exits,
+ * killing those that have not stopped within CMD_GRACE, and reap them.
+ */
+static void
+finish(void)
+{
+	const struct timespec pause = { .tv_nsec = 10000000 };
+	const uint64_t deadline = now_nsec() + CMD_GRACE * 1000000ULL;
+	size_t i, left;
+
+	for (i = 0; i < ncmds; i++)
+		if (cmds[i].pid)
+			(void)kill(-cmds[i].pid, SIGTERM);
+
+	for (;;) {
+		for (i = left = 0; i < ncmds; i++) {
+			if (!cmds[i].pid)
+				continue;
+			if (waitpid(cmds[i].pid, NULL, WNOHANG) == 0)
+				left++;
+			else
+				cmds[i].pid = 0;
+		}
+		if (!left || now_nsec() >= deadline)
+			break;
+		(void)nanosleep(&pause, NULL);
+	}
+
+	for (i = 0; i < ncmds; i++) {
+		if (cmds[i].pid) {
+			(void)kill(-cmds[i].pid, SIGKILL);
+			while (waitpid(cmds[i].pid, NULL, 0) < 0 && errno == EINTR)
+				;
+			cmds[i].pid = 0;
+		}
+	}
+
+	report();
+}
+
+static struct cmd *
+lookup(const char *(*func)(const char *), const char *args)
+{
+	struct cmd *c;
+	size_t i;
+
+	for (i = 0; i < ncmds; i++)
+		if (cmds[i].func == func && cmds[i].args == args)
+			return &cmds[i];
+
+	if (ncmds == LEN(cmds)) {
+		warnx("run_command: Too many commands");
 		return NULL;
 	}
+	if (!ncmds)
+		(void)atexit(finish);
+
+	c = &cmds[ncmds++];
+	memset(c, 0, sizeof(*c));
+	c->func = func;
+	c->args = args;
+	c->fd = -1;
+	c->backoff = COPROC_BACKOFF * 1000000000ULL;
+	if (parse_options(c, args) < 0)
+		c->line = NULL;
+	else
+		split(c);
+
+	return c;
+}
+
+static void
+reap(struct cmd *c, int options)
+{
+	pid_t r;
+
+	while ((r = waitpid(c->pid, NULL, options)) < 0 && errno == EINTR)
+		;
+	if (r == c->pid || (r < 0 && errno == ECHILD)) {
+		c->pid = 0;
+		(void)ev_at(EV_FOREVER, ontimeout, c);
+	}
+}
+
+static void
+close_pipe(struct cmd *c)
+{
+	ev_del(c->fd);
+	(void)close(c->fd);
+	c->fd = -1;
+}
+
+static void
+ontimeout(void *arg)
+{
+	struct cmd *c = arg;
+
+	if (!c->pid)
+		return;
+
+	warnx("run_command '%s': Timed out", c->line);
+	(void)kill(-c->pid, SIGKILL);
+	if (c->fd >= 0)
+		close_pipe(c);
+	reap(c, 0);
+}
+
+static void
+onread(int fd, [[maybe_unused]] unsigned int events, void *arg)
+{
+	struct cmd *c = arg;
+	char tmp[512], *nl;
+	ssize_t n;
+	size_t room;
+
+	while ((n = read(fd, tmp, sizeof(tmp))) > 0) {
+		/* keep the beginning, drain the rest */
+		room = sizeof(c->out) - 1 - c->len;
+		if ((size_t)n > room)
+			n = room;
+		memcpy(c->out + c->len, tmp, n);
+		c->len += n;
+	}
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+	if (n < 0)
+		warn("read '%s'", c->line);
+
+	close_pipe(c);
+	reap(c, WNOHANG);
+
+	c->out[c->len] = '\0';
+	if ((nl = strchr(c->out, '\n')))
+		*nl = '\0';
+
+	if (n == 0 && c->out[0]) {
+		lat_add(&lat_run, c->started);
+		memcpy(c->value, c->out, strlen(c->out) + 1);
+		c->ok = 1;
+		c->fresh = 1;
+		wakeup(run_command, c->args);
+	}
+}
+
+static void
+restart(void *arg)
+{
+	struct cmd *c = arg;
+
+	c->restarting = 0;
+	(void)spawn(c, onlines);
+}
+
+static void
+onlines(int fd, [[maybe_unused]] unsigned int events, void *arg)
+{
+	struct cmd *c = arg;
+	char *nl, *last = NULL;
+	ssize_t n;
+	size_t len;
+
+	while ((n = read(fd, c->out + c->len, sizeof(c->out) - 1 - c->len)) > 0) {
+		c->len += n;
+		c->out[c->len] = '\0';
+
+		/* remember the last complete line, keep the partial one */
+		while ((nl = memchr(c->out, '\n', c->len))) {
+			*nl = '\0';
+			if ((len = nl - c->out) > 0) {
+				memcpy(c->value, c->out, len + 1);
+				last = c->value;
+			}
+			c->len -= len + 1;
+			memmove(c->out, nl + 1, c->len + 1);
+		}
+		/* an overlong line is shown truncated */
+		if (c->len == sizeof(c->out) - 1) {
+			memcpy(c->value, c->out, c->len + 1);
+			last = c->value;
+			c->len = 0;
+		}
+	}
+
+	if (last) {
+		c->ok = 1;
+		c->backoff = COPROC_BACKOFF * 1000000000ULL;
+		wakeup(run_coproc, c->args);
+	}
+
+	if (n < 0 && (errno == EAGAIN || errno == EINTR))
+		return;
+	if (n < 0)
+		warn("read '%s'", c->line);
+
+	/* the coprocess is gone (or at least its output): restart it later */
+	close_pipe(c);
+	if (c->pid) {
+		(void)kill(-c->pid, SIGKILL);
+		reap(c, 0);
+	}
+	warnx("run_coproc '%s': Exited, restarting in %.0f s", c->line,
+	      c->backoff / 1E9);
+	c->restarting = 1;
+	(void)ev_at(now_nsec() + c->backoff, restart, c);
+	if ((c->backoff *= 2) > COPROC_BACKOFF_MAX * 1000000000ULL)
+		c->backoff = COPROC_BACKOFF_MAX * 1000000000ULL;
+}
+
+static int
+spawn(struct cmd *c, ev_fd_fn *fn)
+{
+	char *argv[] = { "/bin/sh", "-c", (char *)c->line, NULL };
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	sigset_t mask;
+	int fds[2], i, ret;
 
-	p = fgets(buf, sizeof(buf) - 1, fp);
-	if (pclose(fp) < 0) {
-		warn("pclose '%s'", cmd);
+	if (pipe(fds) < 0) {
+		warn("pipe");
+		return -1;
+	}
+	for (i = 0; i < 2; i++) {
+		if (fcntl(fds[i], F_SETFD, FD_CLOEXEC) < 0) {
+			warn("fcntl");
+			goto fail;
+		}
+	}
+	if (fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0) {
+		warn("fcntl");
+		goto fail;
+	}
+
+	/* the child must not inherit the signals blocked for the event loop */
+	sigemptyset(&mask);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	sigaddset(&mask, SIGPIPE);
+	posix_spawnattr_setsigdefault(&attr, &mask);
+	/* in its own process group, so that a timeout kills the whole job */
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+	                                POSIX_SPAWN_SETSIGDEF |
+	                                POSIX_SPAWN_SETPGROUP);
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO);
+
+	c->started = now_nsec();
+	if (c->argv[0])
+		ret = posix_spawnp(&c->pid, c->argv[0], &fa, &attr, c->argv,
+		                   environ);
+	else
+		ret = posix_spawn(&c->pid, argv[0], &fa, &attr, argv, environ);
+
+	posix_spawn_file_actions_destroy(&fa);
+	posix_spawnattr_destroy(&attr);
+	(void)close(fds[1]);
+
+	if (ret) {
+		errno = ret;
+		warn("posix_spawn '%s'", c->line);
+		c->pid = 0;
+		(void)close(fds[0]);
+		return -1;
+	}
+
+	c->fd = fds[0];
+	c->len = 0;
+	if (ev_add(c->fd, EV_IN, fn, c) < 0) {
+		(void)kill(-c->pid, SIGKILL);
+		(void)close(c->fd);
+		c->fd = -1;
+		reap(c, 0);
+		return -1;
+	}
+	if (fn == onread)
+		(void)ev_at(c->started + c->timeout, ontimeout, c);
+
+	return 0;
+fail:
+	(void)close(fds[0]);
+	(void)close(fds[1]);
+	return -1;
+}
+
+const char *
+run_command(const char *args)
+{
+	const uint64_t start = now_nsec();
+	struct cmd *c;
+
+	if (!(c = lookup(run_command, args)) || !c->line)
 		return NULL;
+
+	if (c->fresh || c->pid) {
+		c->fresh = 0;
+	} else if (c->ok && start - c->started < c->ttl) {
+		lat_add(&lat_hit, start);
+	} else if (spawn(c, onread) == 0) {
+		lat_add(&lat_spawn, start);
 	}
-	if (p == NULL)
+
+	return c->ok ? c->value : NULL;
+}
+
+const char *
+run_coproc(const char *args)
+{
+	struct cmd *c;
+
+	if (!(c = lookup(run_coproc, args)) || !c->line)
 		return NULL;
 
-	p = strrchr(buf, '\n');
-	if (p != NULL)
-		p[0] = '\0';
+	if (!c->pid && !c->restarting)
+		(void)spawn(c, onlines);
+
+	return c->ok ? c->value : NULL;
+}
+
+/*
+ * Reap the children that have exited after closing their output, on
+ * SIGCHLD. Those still writing are reaped once their output ends, so that
+ * no command is started again before the output of the last run is read.
+ */
+void
+run_reap(void)
+{
+	size_t i;
+
+	for (i = 0; i < ncmds; i++)
+		if (cmds[i].pid && cmds[i].fd < 0)
+			reap(&cmds[i], WNOHANG);
+}
+
+/* whether a run_command is still waiting for the output of its command */
+int
+run_pending(void)
+{
+	size_t i;
+
+	for (i = 0; i < ncmds; i++)
+		if (cmds[i].func == run_command && cmds[i].fd >= 0)
+			return 1;
 
-	return buf[0] ? buf : NULL;
+	return 0;
 }
@@ -1,9 +1,12 @@
 /* See LICENSE file for copyright and license details. */
+#include "../hist.h"
+#include "../meminfo.h"
 #include "../meter.h"
 #include "../slstatus.h"
 #include "../util.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,10 +18,14 @@
 #define HIST_WIDTH 10
 static_assert(HIST_WIDTH > 0, "HIST_WIDTH must be > 0");
 
+static const struct hist_spec hist_spec = {
+	HIST_WIDTH, HIST_WIDTH, HIST_AVG, 0, 1,
+};
+
 #define METER_WIDTH 10
 static_assert(METER_WIDTH > 0, "METER_WIDTH must be > 0");
 
-static uintmax_t free_bytes, total_bytes, used_bytes;
+static thread_local uintmax_t free_bytes, total_bytes, used_bytes;
 
 #if defined(__linux__)
 /*
@@ -30,32 +37,15 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
  */
 
 	static int
-	update_swap_info()
+	read_swap_info(void)
 	{
-		uintmax_t swaptotal, swapfree;
-
-		if (pscanf("/proc/meminfo",
-		              "MemTotal: %*s kB\n" // discard
-		              "MemFree: %*s kB\n" // discard
-		              "MemAvailable: %*s kB\n" // discard
-		              "Buffers: %*s kB\n" // discard
-		              "Cached: %*s kB\n" // discard
-		              "SwapCached: %*s kB\n" // discard
-		              "Active: %*s kB\n" // discard
-		              "Inactive: %*s kB\n" // discard
-		              "Active(anon): %*s kB\n" // discard
-		              "Inactive(anon): %*s kB\n" // discard
-		              "Active(file): %*s kB\n" // discard
-		              "Inactive(file): %*s kB\n" // discard
-		              "Unevictable: %*s kB\n" // discard
-		              "Mlocked: %*s kB\n" // discard
-		              "SwapTotal: %ju kB\n"
-		              "SwapFree: %ju kB\n",
-		              &swaptotal, &swapfree) != 2)
+		const struct meminfo *mi;
+
+		if (!(mi = meminfo(MI(SWAP_TOTAL) | MI(SWAP_FREE))))
 			return -1;
 
-		free_bytes = swapfree * 1024;
-		total_bytes = swaptotal * 1024;
+		free_bytes = mi->bytes[SWAP_FREE];
+		total_bytes = mi->bytes[SWAP_TOTAL];
 		used_bytes = total_bytes - free_bytes;
 
 		return 0;
@@ -68,7 +58,7 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
 	#include <unistd.h>
 
 	static int
-	update_swap_info()
+	read_swap_info(void)
 	{
 		struct swapent *sep, *fsep;
 		int rnswap, nswap, i;
@@ -117,7 +107,7 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
 	#include <unistd.h>
 
 	static int
-	update_swap_info()
+	read_swap_info(void)
 	{
 		kvm_t *kd;
 		struct kvm_swap swap_info[1];
@@ -145,6 +135,19 @@ static uintmax_t free_bytes, total_bytes, used_bytes;
 	}
 #endif
 
+/* read the values at most once per update pass */
+static int
+update_swap_info(void)
+{
+	static thread_local uint64_t updated;
+	static thread_local int ok;
+
+	if (stale(&updated))
+		ok = read_swap_info() == 0;
+
+	return ok ? 0 : -1;
+}
+
 const char *
 swap_free([[maybe_unused]] const char *unused)
 {
@@ -154,31 +157,51 @@ swap_free([[maybe_unused]] const char *unused)
 	return fmt_human_3(free_bytes, 1024);
 }
 
-const char *
-swap_hist([[maybe_unused]] const char *unused)
+static int
+swap_hist_init([[maybe_unused]] const char *unused, void **state)
 {
-	double used;
-	static int initialized;
-	size_t i;
-	static wchar_t hist[HIST_WIDTH + 1];
-
-	if (!initialized) {
-		wmemset(hist, ' ', HIST_WIDTH);
-		hist[HIST_WIDTH] = '\0';
-		initialized = 1;
-	}
+	struct hist *h;
 
-	if (update_swap_info() < 0 || total_bytes == 0)
-		return NULL;
+	*state = h = ecalloc(1, sizeof(*h));
+	hist_init(h, HIST_WIDTH);
 
-	used = (double)used_bytes / total_bytes;
+	return 0;
+}
 
-	for (i = 0; i < HIST_WIDTH - 1; ++i) {
-		hist[i] = hist[i+1];
+static const char *
+swap_hist_sample(void *state)
+{
+	struct hist *h = state;
+
+	if (update_swap_info() < 0 || total_bytes == 0) {
+		hist_push(h, NAN);
+		return NULL;
 	}
-	hist[i] = lower_blocks_1(used);
+	hist_push(h, (double)used_bytes / total_bytes);
+
+	return hist_render(h, &hist_spec);
+}
+
+static void
+swap_hist_fini(void *state)
+{
+	hist_fini(state);
+	free(state);
+}
+
+const struct component_ops swap_hist_ops = {
+	swap_hist_init, swap_hist_sample, swap_hist_fini, 0,
+};
+
+const char *
+swap_hist([[maybe_unused]] const char *unused)
+{
+	static struct hist h;
+
+	if (!h.v)
+		hist_init(&h, HIST_WIDTH);
 
-	return bprintf("%ls", hist);
+	return swap_hist_sample(&h);
 }
 
 const char *
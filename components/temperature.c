@@ -5,6 +5,8 @@
 #include <stddef.h>
 
 #if defined(__linux__)
+	#include "../parse.h"
+
 	#include <stdint.h>
 
 	const char *
@@ -12,7 +14,7 @@
 	{
 		uintmax_t temp;
 
-		if (pscanf(file, "%ju", &temp) != 1)
+		if (readuint(file, &temp) < 0)
 			return NULL;
 
 		return bprintf("%0.f", temp / 1000.0);
@@ -0,0 +1,445 @@
+/* See LICENSE file for copyright and license details. */
+#include "../slstatus.h"
+#include "../util.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* most processes shown by one entry */
+#define TOP_MAX 16
+
+/* initial number of slots of a table of processes, a power of two */
+#define PROCS_INIT 4096
+
+/* a process as sampled last time, or a free slot if pid is 0 */
+struct proc {
+	unsigned long pid;
+	uintmax_t start; /* tells a reused pid apart */
+	uintmax_t ticks; /* utime + stime */
+};
+
+/* processes of the current and of the previous pass, open-addressed */
+struct top {
+	size_t n; /* processes shown */
+	struct proc *cur, *prev;
+	unsigned int bits; /* log2 of the number of slots */
+	size_t used;       /* slots taken in cur */
+	int sampled;
+};
+
+struct best {
+	size_t n;
+	struct {
+		char pid[24];
+		char name[16];
+		double value;
+	} e[TOP_MAX];
+};
+
+static int
+parse_count(const char *arg, size_t *n)
+{
+	char *end;
+	unsigned long v;
+
+	if (!arg || *arg < '0' || *arg > '9' ||
+	    (v = strtoul(arg, &end, 10)) < 1 || v > TOP_MAX || *end) {
+		warnx("top '%s': Expected a count of 1 to %d", arg ? arg : "",
+		      TOP_MAX);
+		return -1;
+	}
+	*n = v;
+
+	return 0;
+}
+
+static void
+copy(char *dst, size_t size, const char *src)
+{
+	const size_t len = strnlen(src, size - 1);
+
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+/* keep the n largest values seen, in descending order */
+static void
+offer(struct best *b, size_t n, const char *pid, const char *name,
+      double value)
+{
+	size_t i;
+
+	if (b->n == n && value <= b->e[n - 1].value)
+		return;
+	for (i = b->n < n ? b->n++ : n - 1; i > 0 && b->e[i - 1].value < value;
+	     i--)
+		b->e[i] = b->e[i - 1];
+	copy(b->e[i].pid, sizeof(b->e[i].pid), pid);
+	copy(b->e[i].name, sizeof(b->e[i].name), name);
+	b->e[i].value = value;
+}
+
+/* "name share%" of each process, separated by blanks */
+static const char *
+show(const struct best *b)
+{
+	char out[TOP_MAX * 32];
+	size_t i, len = 0;
+	int r;
+
+	out[0] = '\0';
+	for (i = 0; i < b->n; i++) {
+		if ((r = esnprintf(out + len, sizeof(out) - len, "%s%s %.0f%%",
+		                   i ? " " : "", b->e[i].name,
+		                   b->e[i].value)) < 0)
+			return NULL;
+		len += r;
+	}
+
+	return bprintf("%s", out);
+}
+
+#if defined(__linux__)
+	#include "../meminfo.h"
+	#include "../parse.h"
+
+	#include <fcntl.h>
+	#include <stdalign.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+
+	/* as returned by getdents64, which glibc only wraps since 2.30 */
+	struct linux_dirent64 {
+		uint64_t d_ino;
+		int64_t d_off;
+		unsigned short d_reclen;
+		unsigned char d_type;
+		char d_name[];
+	};
+
+	static thread_local int procfd = -1;
+
+	/* call fn for every process, reading /proc in large batches */
+	static int
+	walk(void (*fn)(const char *pid, void *arg), void *arg)
+	{
+		static thread_local alignas(8) char dents[32768];
+		const struct linux_dirent64 *d;
+		long n, off;
+
+		if (procfd < 0 && (procfd = open("/proc", O_RDONLY | O_DIRECTORY |
+		                                 O_CLOEXEC)) < 0) {
+			warn("open '/proc'");
+			return -1;
+		}
+		if (lseek(procfd, 0, SEEK_SET) < 0) {
+			warn("lseek '/proc'");
+			return -1;
+		}
+
+		while ((n = syscall(SYS_getdents64, procfd, dents,
+		                    sizeof(dents))) > 0) {
+			for (off = 0; off < n; off += d->d_reclen) {
+				d = (const struct linux_dirent64 *)(dents + off);
+				if (d->d_name[0] >= '1' && d->d_name[0] <= '9')
+					fn(d->d_name, arg);
+			}
+		}
+		if (n < 0) {
+			warn("getdents64 '/proc'");
+			return -1;
+		}
+
+		return 0;
+	}
+
+	/* read a file of a process, quietly, as it may be gone already */
+	static ssize_t
+	readat(const char *pid, const char *file, char *dst, size_t size)
+	{
+		char path[64];
+		ssize_t n;
+		int fd;
+
+		if (esnprintf(path, sizeof(path), "%s/%s", pid, file) < 0 ||
+		    (fd = openat(procfd, path, O_RDONLY | O_CLOEXEC)) < 0)
+			return -1;
+		n = read(fd, dst, size - 1);
+		(void)close(fd);
+		if (n < 0)
+			return -1;
+		dst[n] = '\0';
+
+		return n;
+	}
+
+	/* skip n fields separated by single blanks */
+	static const char *
+	skip(const char *p, size_t n)
+	{
+		for (; n && p; n--)
+			if ((p = strchr(p, ' ')))
+				p++;
+
+		return p;
+	}
+
+	/* name, utime + stime and start time from /proc/<pid>/stat */
+	static int
+	read_stat(const char *pid, char name[16], uintmax_t *ticks,
+	          uintmax_t *start)
+	{
+		char text[1024];
+		const char *l, *r;
+		struct parser ps;
+		uintmax_t t[2];
+		size_t len;
+
+		if (readat(pid, "stat", text, sizeof(text)) < 0)
+			return -1;
+
+		/* the name may contain blanks and parentheses itself */
+		if (!(l = strchr(text, '(')) || !(r = strrchr(text, ')')) || r < l)
+			return -1;
+		len = MIN((size_t)(r - l - 1), (size_t)15);
+		memcpy(name, l + 1, len);
+		name[len] = '\0';
+
+		/* utime and stime are fields 14 and 15, starttime is 22 */
+		if (!(l = skip(r + 2, 11)))
+			return -1;
+		parse_init(&ps, "stat", l);
+		if (parse_row(&ps, t, LEN(t)) < 0 || !(l = skip(ps.p + 1, 6)))
+			return -1;
+		ps.p = l;
+		if (parse_uint(&ps, start) < 0)
+			return -1;
+		*ticks = t[0] + t[1];
+
+		return 0;
+	}
+
+	static size_t
+	slot(const struct proc *table, unsigned int bits, unsigned long pid)
+	{
+		const size_t mask = ((size_t)1 << bits) - 1;
+		size_t i = (uint64_t)pid * 0x9E3779B97F4A7C15ULL >> (64 - bits);
+
+		while (table[i].pid && table[i].pid != pid)
+			i = (i + 1) & mask;
+
+		return i;
+	}
+
+	/* double the tables, keeping the load factor at most 1/2 */
+	static void
+	grow(struct top *t)
+	{
+		struct proc *tables[2] = { t->cur, t->prev }, *old;
+		const size_t oldsize = (size_t)1 << t->bits;
+		size_t i, j;
+
+		t->bits++;
+		for (j = 0; j < LEN(tables); j++) {
+			old = tables[j];
+			tables[j] = ecalloc((size_t)1 << t->bits, sizeof(*old));
+			for (i = 0; i < oldsize; i++)
+				if (old[i].pid)
+					tables[j][slot(tables[j], t->bits,
+					               old[i].pid)] = old[i];
+			free(old);
+		}
+		t->cur = tables[0];
+		t->prev = tables[1];
+	}
+
+	struct cpu_pass {
+		struct top *t;
+		struct best best;
+		double scale; /* from ticks to percent */
+	};
+
+	static void
+	sample_cpu(const char *pid, void *arg)
+	{
+		struct cpu_pass *pass = arg;
+		struct top *t = pass->t;
+		const struct proc *old;
+		struct proc *p;
+		char name[16];
+		uintmax_t ticks, start;
+		unsigned long id = strtoul(pid, NULL, 10);
+
+		if (read_stat(pid, name, &ticks, &start) < 0)
+			return;
+
+		if (2 * (t->used + 1) > (size_t)1 << t->bits)
+			grow(t);
+		p = &t->cur[slot(t->cur, t->bits, id)];
+		*p = (struct proc){ .pid = id, .start = start, .ticks = ticks };
+		t->used++;
+
+		/* processes started since the last pass count from zero */
+		old = &t->prev[slot(t->prev, t->bits, id)];
+		if (old->pid && old->start == start && old->ticks <= ticks)
+			ticks -= old->ticks;
+		if (t->sampled && ticks)
+			offer(&pass->best, t->n, pid, name, ticks * pass->scale);
+	}
+
+	static int
+	top_cpu_init(const char *arg, void **state)
+	{
+		struct top *t;
+
+		t = ecalloc(1, sizeof(*t));
+		if (parse_count(arg, &t->n) < 0) {
+			free(t);
+			return -1;
+		}
+		*state = t;
+
+		return 0;
+	}
+
+	static const char *
+	top_cpu_sample(void *state)
+	{
+		struct top *t = state;
+		struct cpu_pass pass = { .t = t };
+		struct proc *swap;
+		long hz;
+
+		if ((hz = sysconf(_SC_CLK_TCK)) <= 0) {
+			warn("sysconf '_SC_CLK_TCK'");
+			return NULL;
+		}
+		pass.scale = 100 / (hz * delta_time);
+
+		if (!t->bits) {
+			t->bits = __builtin_ctzll(PROCS_INIT);
+			t->cur = ecalloc(PROCS_INIT, sizeof(*t->cur));
+			t->prev = ecalloc(PROCS_INIT, sizeof(*t->prev));
+		}
+		t->used = 0;
+		if (walk(sample_cpu, &pass) < 0)
+			return NULL;
+
+		/* this pass becomes the previous one, and its table is reused */
+		swap = t->prev;
+		t->prev = t->cur;
+		t->cur = swap;
+		memset(t->cur, 0, ((size_t)1 << t->bits) * sizeof(*t->cur));
+		if (!t->sampled) {
+			t->sampled = 1;
+			return NULL;
+		}
+
+		return show(&pass.best);
+	}
+
+	static void
+	top_cpu_fini(void *state)
+	{
+		struct top *t = state;
+
+		free(t->cur);
+		free(t->prev);
+		free(t);
+	}
+
+	struct mem_pass {
+		size_t n;
+		struct best best;
+	};
+
+	static void
+	sample_mem(const char *pid, void *arg)
+	{
+		struct mem_pass *pass = arg;
+		struct parser ps;
+		uintmax_t pages[2]; /* size and resident */
+		char text[128];
+
+		if (readat(pid, "statm", text, sizeof(text)) < 0)
+			return;
+		parse_init(&ps, "statm", text);
+		if (parse_nums(&ps, pages, LEN(pages)) < LEN(pages) || !pages[1])
+			return;
+
+		/* names are looked up for the winners only */
+		offer(&pass->best, pass->n, pid, "", pages[1]);
+	}
+
+	const char *
+	top_mem(const char *arg)
+	{
+		struct mem_pass pass = { 0 };
+		const struct meminfo *mi;
+		long pagesize;
+		size_t i;
+		char *nl;
+
+		if (parse_count(arg, &pass.n) < 0 ||
+		    !(mi = meminfo(MI(MEM_TOTAL))) || !mi->bytes[MEM_TOTAL])
+			return NULL;
+		if ((pagesize = sysconf(_SC_PAGESIZE)) <= 0) {
+			warn("sysconf '_SC_PAGESIZE'");
+			return NULL;
+		}
+		if (walk(sample_mem, &pass) < 0)
+			return NULL;
+
+		for (i = 0; i < pass.best.n; i++) {
+			if (readat(pass.best.e[i].pid, "comm", pass.best.e[i].name,
+			           sizeof(pass.best.e[i].name)) < 0)
+				copy(pass.best.e[i].name,
+				     sizeof(pass.best.e[i].name), "?");
+			if ((nl = strchr(pass.best.e[i].name, '\n')))
+				*nl = '\0';
+			pass.best.e[i].value *= 100.0 * pagesize /
+			                        mi->bytes[MEM_TOTAL];
+		}
+
+		return show(&pass.best);
+	}
+#else
+	static int
+	top_cpu_init([[maybe_unused]] const char *arg,
+	             [[maybe_unused]] void **state)
+	{
+		warnx("top_cpu and top_mem are only supported on Linux");
+		return -1;
+	}
+
+	static const char *
+	top_cpu_sample([[maybe_unused]] void *state)
+	{
+		return NULL;
+	}
+
+	#define top_cpu_fini free
+
+	const char *
+	top_mem([[maybe_unused]] const char *arg)
+	{
+		return NULL;
+	}
+#endif
+
+const struct component_ops top_cpu_ops = {
+	top_cpu_init, top_cpu_sample, top_cpu_fini, 0,
+};
+
+/*
+ * Only the key of top_cpu_ops, through which every entry is sampled: the
+ * state of a plain function would be shared between the worker threads.
+ */
+const char *
+top_cpu([[maybe_unused]] const char *arg)
+{
+	return NULL;
+}
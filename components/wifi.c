@@ -32,39 +32,26 @@
 		size_t i;
 		char *p, *datastart;
 		char path[PATH_MAX];
-		char status[5];
-		FILE *fp;
+		char status[16];
 		double pct;
 
 		if (esnprintf(path, sizeof(path), NET_OPERSTATE, interface) < 0)
 			return NULL;
-		fp = fopen(path, "r");
-		if (fp == NULL) {
-			warn("fopen '%s'", path);
-			return NULL;
-		}
-		p = fgets(status, sizeof(status), fp);
-		if (fclose(fp) < 0)
-			err(EXIT_FAILURE, "fclose");
-		if (!p || strcmp(status, "up\n") != 0)
+		if (readfile(path, status, sizeof(status)) < 0 ||
+		    strcmp(status, "up\n") != 0)
 			return NULL;
 
-		fp = fopen("/proc/net/wireless", "r");
-		if (fp == NULL) {
-			warn("fopen '/proc/net/wireless'");
+		if (readfile("/proc/net/wireless", buf, sizeof(buf)) < 0)
 			return NULL;
-		}
-
-		for (i = 0; i < 3; i++)
-			if (!(p = fgets(buf, sizeof(buf) - 1, fp)))
-				break;
 
-		if (fclose(fp) < 0)
-			err(EXIT_FAILURE, "fclose");
-		if (i < 2 || !p)
+		/* skip the two header lines */
+		for (i = 0, p = buf; i < 2 && p; i++)
+			if ((p = strchr(p, '\n')))
+				p++;
+		if (!p || !*p)
 			return NULL;
 
-		if (!(datastart = strstr(buf, interface)))
+		if (!(datastart = strstr(p, interface)))
 			return NULL;
 
 		datastart = (datastart+(strlen(interface)+1));
@@ -1,6 +1,6 @@
 /* See LICENSE file for copyright and license details. */
 
-/* interval between updates (in ms) */
+/* default interval between updates (in ms) */
 const unsigned int interval = 1000;
 
 /* text to show if no value can be retrieved */
@@ -19,8 +19,26 @@ static const char unknown_str[] = "n/a";
  * battery_state       battery charging state          battery name (BAT0)
  *                                                     NULL on OpenBSD/FreeBSD
  * cat                 read arbitrary file             path
+ * cpu_core_perc       usage of one cpu in percent     cpu number (0)
+ * cpu_cores           usage of every cpu as blocks    NULL
  * cpu_freq            cpu frequency in MHz            NULL
+ * cpu_freq_avg        average frequency of all cpus   NULL (Linux only)
+ * cpu_freq_cores      frequency of every cpu as       NULL (Linux only)
+ *                     blocks, within its own range
+ * cpu_freq_max        highest frequency of all cpus   NULL (Linux only)
+ * cpu_freq_min        lowest frequency of all cpus    NULL (Linux only)
+ * cpu_max_perc        usage of the busiest cpu        NULL
  * cpu_perc            cpu usage in percent            NULL
+ * cpu_stack           cpu time by state, ascii meter  NULL
+ *                                                     (user '=', nice '-',
+ *                                                     system '#', iowait 'w',
+ *                                                     irq 'i', softirq 's',
+ *                                                     steal '!')
+ * cpu_state_perc      cpu time of a state in percent  state (steal)
+ *                                                     user, nice, system,
+ *                                                     idle, iowait, irq,
+ *                                                     softirq, steal, guest,
+ *                                                     guest_nice
  * datetime            date and time                   format string (%F %T)
  * disk_free           free disk space in GB           mountpoint path (/)
  * disk_perc           disk usage in percent           mountpoint path (/)
@@ -29,6 +47,9 @@ static const char unknown_str[] = "n/a";
  * entropy             available entropy               NULL
  * gid                 GID of current user             NULL
  * hostname            hostname                        NULL
+ * irq_rate            interrupts per second           cpu number (0), or
+ *                                                     NULL for all cpus
+ *                                                     (Linux only)
  * ipv4                IPv4 address                    interface name (eth0)
  * ipv6                IPv6 address                    interface name (eth0)
  * kernel_release      `uname -r`                      NULL
@@ -41,11 +62,33 @@ static const char unknown_str[] = "n/a";
  * netspeed_tx         transfer network speed          interface name (wlan0)
  * num_files           number of files in a directory  path
  *                                                     (/home/foo/Inbox/cur)
+ * psi_avg10           pressure stall information,     resource and kind
+ *                     share of time stalled over the  (memory some)
+ *                     last 10s in percent             cpu|io|memory
+ *                                                     some|full, optionally
+ *                                                     followed by a trigger
+ *                                                     threshold and window
+ *                                                     in microseconds
+ *                                                     (memory some 150000
+ *                                                     2000000) that updates
+ *                                                     the entry at once.
+ *                                                     Without privileges the
+ *                                                     window must be a
+ *                                                     multiple of 2s.
+ *                                                     (Linux only)
+ * psi_rate            share of time stalled since     same as psi_avg10
+ *                     the previous update in percent
  * ram_free            free memory in GB               NULL
  * ram_perc            memory usage in percent         NULL
  * ram_total           total memory size in GB         NULL
  * ram_used            used memory in GB               NULL
  * run_command         custom shell command            command (echo foo)
+ *                                                     see run_command.c
+ * run_coproc          last line of a long-running     command (tail -f foo)
+ *                     command                         see run_command.c
+ * softirq_rate        softirqs per second             cpu number (0), or
+ *                                                     NULL for all cpus
+ *                                                     (Linux only)
  * swap_free           free swap in GB                 NULL
  * swap_perc           swap usage in percent           NULL
  * swap_total          total swap size in GB           NULL
@@ -55,6 +98,12 @@ static const char unknown_str[] = "n/a";
  *                                                     NULL on OpenBSD
  *                                                     thermal zone on FreeBSD
  *                                                     (tz0, tz1, etc.)
+ * top_cpu             processes using the most cpu    count of processes (3)
+ *                     since the previous update, with (Linux only)
+ *                     their share of one cpu
+ * top_mem             processes with the largest      count of processes (3)
+ *                     resident memory, with their     (Linux only)
+ *                     share of the total
  * uid                 UID of current user             NULL
  * up                  interface is up                 interface name (eth0)
  * uptime              system uptime                   NULL
@@ -63,6 +112,54 @@ static const char unknown_str[] = "n/a";
  *                                                     NULL on OpenBSD/FreeBSD
  * wifi_essid          WiFi ESSID                      interface name (wlan0)
  * wifi_perc           WiFi signal in percent          interface name (wlan0)
+ *
+ * The format may contain one %s conversion with an optional '-' flag, width
+ * and precision, and %% for a literal '%'. Other formats are rejected at
+ * startup.
+ *
+ * Components that keep a history (cpu_*, netspeed_*, ram_hist, swap_hist,
+ * counter and clockdiff) keep it per entry, so they may be listed several
+ * times, e.g. netspeed_rx for two interfaces. Invalid arguments of these are
+ * reported at startup.
+ *
+ * Each component may be given its own update interval (in ms) as a fourth
+ * field. Components without one (or with 0) are updated every `interval`.
+ *
+ * Components that may block (disk_*, ipv4, ipv6, up, keymap and wifi_essid)
+ * or take long (top_cpu and top_mem) are run on worker threads so they never
+ * delay the others. A fifth field of F_INLINE or F_OFFLOAD overrides this;
+ * offloaded components must not share state with other components.
+ * run_command and run_coproc are asynchronous and must stay inline.
+ *
+ * Entries with the same function, argument, interval and flags are evaluated
+ * once per update and the value is shown through each of their formats.
+ * F_NODEDUP (which may be combined with the flags above) keeps an entry
+ * separate; counter and clockdiff are never shared.
+ *
+ * gid, hostname, kernel_release, uid and username are evaluated once at
+ * startup and again on SIGHUP, unless they are given an interval. F_CONST
+ * does the same for any other entry.
+ *
+ * A seventh field shows a sparkline of the values of an entry instead of the
+ * value itself, for any component that produces a number:
+ *
+ *	{ netspeed_rx, "%s", "eth0", 0, 0, NULL,
+ *	  { .width = 10, .span = 60, .agg = HIST_MAX } },
+ *
+ * draws the last 60 updates as 10 characters, each the largest of 6 values.
+ * .agg may also be HIST_MIN or HIST_AVG (the default), .span defaults to
+ * .width, and values from .lo to .hi fill the characters; without .hi they
+ * are scaled to the largest one shown.
+ *
+ * An eighth field shows the values of the last .secs seconds combined into
+ * one, printed like the value itself:
+ *
+ *	{ netspeed_rx, "%s", "eth0", 0, 0, NULL, { 0 },
+ *	  { .secs = 60, .agg = WINDOW_MAX } },
+ *
+ * shows the highest rate of the last minute. .agg may also be WINDOW_MIN or
+ * WINDOW_AVG (the default). Given both, the sparkline draws the combined
+ * values.
  */
 static const struct arg args[] = {
 	/* function format          argument */
@@ -12,7 +12,7 @@ MANDIR ?= $(PREFIX)/share/man
 
 # includes and libs
 #INCS = `pkg-config --cflags x11`
-LIBS = `pkg-config --libs   x11`
+LIBS = `pkg-config --libs   x11` -lpthread
 
 # flags
 CPPFLAGS = -MMD -MP
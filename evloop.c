@@ -0,0 +1,458 @@
+/* See LICENSE file for copyright and license details. */
+#include "evloop.h"
+#include "util.h"
+
+#include <err.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct {
+	int fd;
+	unsigned int events;
+	ev_fd_fn *fn;
+	void *arg;
+} watchers[EV_MAX];
+
+static struct {
+	uint64_t when;
+	ev_timer_fn *fn;
+	void *arg;
+} timers[EV_MAX];
+
+static ev_sig_fn *sigfns[NSIG];
+
+static int
+slot_add(int fd, unsigned int events, ev_fd_fn *fn, void *arg)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(watchers); i++) {
+		if (!watchers[i].fn) {
+			watchers[i].fd = fd;
+			watchers[i].events = events;
+			watchers[i].fn = fn;
+			watchers[i].arg = arg;
+			return i;
+		}
+	}
+
+	warnx("ev_add: Too many watched file descriptors");
+	return -1;
+}
+
+static int
+slot_find(int fd)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(watchers); i++)
+		if (watchers[i].fn && watchers[i].fd == fd)
+			return i;
+
+	return -1;
+}
+
+static void
+slot_call(size_t i, int fd, unsigned int events)
+{
+	/* the watcher may have been removed by an earlier callback */
+	if (watchers[i].fn && watchers[i].fd == fd)
+		watchers[i].fn(fd, events, watchers[i].arg);
+}
+
+#if defined(__linux__)
+	#include <sys/epoll.h>
+	#include <sys/signalfd.h>
+	#include <sys/timerfd.h>
+
+	/* epoll data of the internal file descriptors */
+	#define TIMER_SLOT  EV_MAX
+	#define SIGNAL_SLOT (EV_MAX + 1)
+
+	static int epfd = -1, tfd = -1, sfd = -1;
+	static sigset_t sigs;
+	static uint64_t armed = EV_FOREVER;
+
+	static uint64_t
+	pack(int fd, size_t slot)
+	{
+		return (uint64_t)(unsigned int)fd << 32 | slot;
+	}
+
+	int
+	ev_init(void)
+	{
+		struct epoll_event ev = { .events = EPOLLIN };
+
+		sigemptyset(&sigs);
+
+		if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+			warn("epoll_create1");
+			return -1;
+		}
+		if ((tfd = timerfd_create(CLOCK_MONOTONIC,
+		                          TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+			warn("timerfd_create");
+			return -1;
+		}
+		ev.data.u64 = pack(tfd, TIMER_SLOT);
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0) {
+			warn("epoll_ctl 'timerfd'");
+			return -1;
+		}
+
+		return 0;
+	}
+
+	void
+	ev_fini(void)
+	{
+		if (sfd >= 0)
+			(void)close(sfd);
+		if (tfd >= 0)
+			(void)close(tfd);
+		if (epfd >= 0)
+			(void)close(epfd);
+		sfd = tfd = epfd = -1;
+	}
+
+	int
+	ev_add(int fd, unsigned int events, ev_fd_fn *fn, void *arg)
+	{
+		struct epoll_event ev = { 0 };
+		int i;
+
+		if ((i = slot_add(fd, events, fn, arg)) < 0)
+			return -1;
+
+		if (events & EV_IN)
+			ev.events |= EPOLLIN;
+		if (events & EV_PRI)
+			ev.events |= EPOLLPRI;
+		ev.data.u64 = pack(fd, i);
+
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			warn("epoll_ctl %d", fd);
+			watchers[i].fn = NULL;
+			return -1;
+		}
+
+		return 0;
+	}
+
+	void
+	ev_del(int fd)
+	{
+		int i;
+
+		if ((i = slot_find(fd)) < 0)
+			return;
+
+		if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) < 0)
+			warn("epoll_ctl %d", fd);
+		watchers[i].fn = NULL;
+	}
+
+	int
+	ev_signal(int signo, ev_sig_fn *fn)
+	{
+		struct epoll_event ev = { .events = EPOLLIN };
+		int fd;
+
+		sigaddset(&sigs, signo);
+		if (sigprocmask(SIG_BLOCK, &sigs, NULL) < 0) {
+			warn("sigprocmask");
+			return -1;
+		}
+		if ((fd = signalfd(sfd, &sigs, SFD_NONBLOCK | SFD_CLOEXEC)) < 0) {
+			warn("signalfd");
+			return -1;
+		}
+		if (sfd < 0) {
+			ev.data.u64 = pack(fd, SIGNAL_SLOT);
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+				warn("epoll_ctl 'signalfd'");
+				(void)close(fd);
+				return -1;
+			}
+			sfd = fd;
+		}
+		sigfns[signo] = fn;
+
+		return 0;
+	}
+
+	static void
+	read_timer(void)
+	{
+		uint64_t expirations;
+
+		if (read(tfd, &expirations, sizeof(expirations)) < 0 &&
+		    errno != EAGAIN)
+			warn("read 'timerfd'");
+		armed = EV_FOREVER;
+	}
+
+	static void
+	read_signals(void)
+	{
+		struct signalfd_siginfo si;
+
+		while (read(sfd, &si, sizeof(si)) == sizeof(si))
+			if (si.ssi_signo < LEN(sigfns) && sigfns[si.ssi_signo])
+				sigfns[si.ssi_signo](si.ssi_signo);
+	}
+
+	static void
+	wait_events(uint64_t deadline)
+	{
+		struct epoll_event evs[16];
+		struct itimerspec its = { 0 };
+		unsigned int events;
+		size_t slot;
+		int i, n, fd;
+
+		if (deadline != armed) {
+			if (deadline != EV_FOREVER)
+				its.it_value = nsec_to_timespec(deadline);
+			if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+				err(EXIT_FAILURE, "timerfd_settime");
+			armed = deadline;
+		}
+
+		if ((n = epoll_wait(epfd, evs, LEN(evs), -1)) < 0) {
+			if (errno != EINTR)
+				err(EXIT_FAILURE, "epoll_wait");
+			return;
+		}
+
+		for (i = 0; i < n; i++) {
+			fd = evs[i].data.u64 >> 32;
+			slot = evs[i].data.u64 & UINT32_MAX;
+
+			if (slot == TIMER_SLOT) {
+				read_timer();
+			} else if (slot == SIGNAL_SLOT) {
+				read_signals();
+			} else {
+				events = 0;
+				if (evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					events |= EV_IN;
+				if (evs[i].events & EPOLLPRI)
+					events |= EV_PRI;
+				slot_call(slot, fd, events);
+			}
+		}
+	}
+#else
+	#include <fcntl.h>
+	#include <limits.h>
+	#include <poll.h>
+
+	/* self-pipe used to turn signals into readable events */
+	static int sigpipe[2] = { -1, -1 };
+
+	static void
+	onsignal(int signo)
+	{
+		const unsigned char c = signo;
+		const int saved = errno;
+
+		(void)write(sigpipe[1], &c, 1);
+		errno = saved;
+	}
+
+	int
+	ev_init(void)
+	{
+		size_t i;
+
+		if (pipe(sigpipe) < 0) {
+			warn("pipe");
+			return -1;
+		}
+		for (i = 0; i < LEN(sigpipe); i++) {
+			if (fcntl(sigpipe[i], F_SETFL, O_NONBLOCK) < 0 ||
+			    fcntl(sigpipe[i], F_SETFD, FD_CLOEXEC) < 0) {
+				warn("fcntl");
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	void
+	ev_fini(void)
+	{
+		size_t i;
+
+		for (i = 0; i < LEN(sigpipe); i++) {
+			if (sigpipe[i] >= 0)
+				(void)close(sigpipe[i]);
+			sigpipe[i] = -1;
+		}
+	}
+
+	int
+	ev_add(int fd, unsigned int events, ev_fd_fn *fn, void *arg)
+	{
+		return slot_add(fd, events, fn, arg) < 0 ? -1 : 0;
+	}
+
+	void
+	ev_del(int fd)
+	{
+		int i;
+
+		if ((i = slot_find(fd)) >= 0)
+			watchers[i].fn = NULL;
+	}
+
+	int
+	ev_signal(int signo, ev_sig_fn *fn)
+	{
+		struct sigaction act = { 0 };
+
+		sigemptyset(&act.sa_mask);
+		act.sa_handler = onsignal;
+		act.sa_flags = SA_RESTART;
+		if (sigaction(signo, &act, NULL) < 0) {
+			warn("sigaction %d", signo);
+			return -1;
+		}
+		sigfns[signo] = fn;
+
+		return 0;
+	}
+
+	static void
+	read_signals(void)
+	{
+		unsigned char c;
+
+		while (read(sigpipe[0], &c, 1) == 1)
+			if (c < LEN(sigfns) && sigfns[c])
+				sigfns[c](c);
+	}
+
+	static void
+	wait_events(uint64_t deadline)
+	{
+		struct pollfd pfds[EV_MAX + 1];
+		int slots[EV_MAX + 1];
+		struct timespec ts;
+		uint64_t now, timeout = INT_MAX;
+		unsigned int events;
+		size_t i, n;
+
+		if (deadline != EV_FOREVER) {
+			if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+				err(EXIT_FAILURE, "clock_gettime");
+			now = timespec_to_nsec(&ts);
+			/* round up so that the deadline has passed on return */
+			timeout = deadline > now ? (deadline - now + 999999) / 1000000 : 0;
+			if (timeout > INT_MAX)
+				timeout = INT_MAX;
+		}
+
+		pfds[0] = (struct pollfd){ .fd = sigpipe[0], .events = POLLIN };
+		for (i = 0, n = 1; i < LEN(watchers); i++) {
+			if (!watchers[i].fn)
+				continue;
+			pfds[n] = (struct pollfd){ .fd = watchers[i].fd };
+			if (watchers[i].events & EV_IN)
+				pfds[n].events |= POLLIN;
+			if (watchers[i].events & EV_PRI)
+				pfds[n].events |= POLLPRI;
+			slots[n++] = i;
+		}
+
+		if (poll(pfds, n, deadline == EV_FOREVER ? -1 : (int)timeout) < 0) {
+			if (errno != EINTR)
+				err(EXIT_FAILURE, "poll");
+			return;
+		}
+
+		if (pfds[0].revents & POLLIN)
+			read_signals();
+		for (i = 1; i < n; i++) {
+			events = 0;
+			if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+				events |= EV_IN;
+			if (pfds[i].revents & POLLPRI)
+				events |= EV_PRI;
+			if (events)
+				slot_call(slots[i], pfds[i].fd, events);
+		}
+	}
+#endif
+
+/*
+ * Call fn(arg) once at when (CLOCK_MONOTONIC, in ns), replacing any timer
+ * already set for the same fn and arg. EV_FOREVER cancels the timer.
+ */
+int
+ev_at(uint64_t when, ev_timer_fn *fn, void *arg)
+{
+	size_t i, unused = LEN(timers);
+
+	for (i = 0; i < LEN(timers); i++) {
+		if (timers[i].fn == fn && timers[i].arg == arg)
+			break;
+		if (!timers[i].fn && unused == LEN(timers))
+			unused = i;
+	}
+
+	if (when == EV_FOREVER) {
+		if (i < LEN(timers))
+			timers[i].fn = NULL;
+		return 0;
+	}
+
+	if (i == LEN(timers) && (i = unused) == LEN(timers)) {
+		warnx("ev_at: Too many timers");
+		return -1;
+	}
+
+	timers[i].when = when;
+	timers[i].fn = fn;
+	timers[i].arg = arg;
+
+	return 0;
+}
+
+/*
+ * Wait until deadline (CLOCK_MONOTONIC, in ns), a timer expires, or a
+ * watched file descriptor or signal is ready, and dispatch the callbacks.
+ */
+void
+ev_wait(uint64_t deadline)
+{
+	struct timespec ts;
+	ev_timer_fn *fn;
+	uint64_t now;
+	size_t i;
+
+	for (i = 0; i < LEN(timers); i++)
+		if (timers[i].fn && timers[i].when < deadline)
+			deadline = timers[i].when;
+
+	wait_events(deadline);
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EXIT_FAILURE, "clock_gettime");
+	now = timespec_to_nsec(&ts);
+
+	for (i = 0; i < LEN(timers); i++) {
+		if (timers[i].fn && timers[i].when <= now) {
+			fn = timers[i].fn;
+			timers[i].fn = NULL;
+			fn(timers[i].arg);
+		}
+	}
+}
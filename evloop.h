@@ -0,0 +1,26 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stdint.h>
+
+/* maximum number of watched file descriptors */
+#define EV_MAX 64
+
+/* watched events */
+#define EV_IN  0x1
+#define EV_PRI 0x2
+
+/* no deadline, see ev_wait() */
+#define EV_FOREVER UINT64_MAX
+
+typedef void ev_fd_fn(int fd, unsigned int events, void *arg);
+typedef void ev_sig_fn(int signo);
+typedef void ev_timer_fn(void *arg);
+
+int ev_init(void);
+void ev_fini(void);
+int ev_add(int fd, unsigned int events, ev_fd_fn *fn, void *arg);
+void ev_del(int fd);
+int ev_signal(int signo, ev_sig_fn *fn);
+int ev_at(uint64_t when, ev_timer_fn *fn, void *arg);
+void ev_wait(uint64_t deadline);
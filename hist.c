@@ -0,0 +1,96 @@
+/* See LICENSE file for copyright and license details. */
+#include "hist.h"
+#include "meter.h"
+#include "util.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+/* widest sparkline that fits into buf */
+#define HIST_WIDTH_MAX 255
+
+void
+hist_init(struct hist *h, size_t span)
+{
+	size_t size = 1;
+
+	while (size < span)
+		size <<= 1;
+	h->v = ecalloc(size, sizeof(*h->v));
+	h->mask = size - 1;
+	h->n = 0;
+}
+
+void
+hist_fini(struct hist *h)
+{
+	free(h->v);
+	h->v = NULL;
+}
+
+void
+hist_push(struct hist *h, double v)
+{
+	h->v[h->n++ & h->mask] = v;
+}
+
+/* combine the samples from first up to, but not including, last */
+static double
+bucket(const struct hist *h, uint64_t first, uint64_t last, enum hist_agg agg)
+{
+	double v, acc = NAN;
+	size_t n = 0;
+
+	for (; first < last; first++) {
+		if (isnan(v = h->v[first & h->mask]))
+			continue;
+		if (!n++)
+			acc = v;
+		else if (agg == HIST_MIN)
+			acc = MIN(acc, v);
+		else if (agg == HIST_MAX)
+			acc = MAX(acc, v);
+		else
+			acc += v;
+	}
+
+	return agg == HIST_AVG && n ? acc / n : acc;
+}
+
+/*
+ * Downsample the last span samples into width buckets of span / width
+ * samples each, spreading the remainder, and draw them as blocks. Buckets
+ * without any value are left blank.
+ */
+const char *
+hist_render(const struct hist *h, const struct hist_spec *s)
+{
+	const size_t width = MIN(s->width, HIST_WIDTH_MAX);
+	const size_t span = MIN(MAX(s->span, width), h->mask + 1);
+	wchar_t line[HIST_WIDTH_MAX + 1];
+	double v[HIST_WIDTH_MAX], lo = s->lo, hi = s->hi;
+	const int64_t base = (int64_t)h->n - (int64_t)span;
+	int64_t first, last;
+	size_t i;
+
+	/* samples before the first one pushed count as missing */
+	for (i = 0; i < width; i++) {
+		first = base + (int64_t)(span * i / width);
+		last = base + (int64_t)(span * (i + 1) / width);
+		v[i] = bucket(h, MAX(first, 0), MAX(last, 0), s->agg);
+	}
+
+	if (hi <= lo) {
+		for (i = 0, lo = 0, hi = 0; i < width; i++)
+			if (v[i] > hi)
+				hi = v[i];
+	}
+
+	for (i = 0; i < width; i++)
+		line[i] = isnan(v[i]) ? L' ' : hi <= lo ? lower_blocks_1(0) :
+		          lower_blocks_1((v[i] - lo) / (hi - lo));
+	line[i] = L'\0';
+
+	return bprintf("%ls", line);
+}
@@ -0,0 +1,36 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* how the samples that fall into one character are combined */
+enum hist_agg {
+	HIST_AVG,
+	HIST_MIN,
+	HIST_MAX,
+};
+
+/*
+ * A sparkline of width characters over the last span samples, newest on
+ * the right. Values from lo to hi are mapped onto the block heights; if hi
+ * is not above lo, the highest character is scaled to hi = largest value.
+ */
+struct hist_spec {
+	unsigned int width; /* 0 for none */
+	unsigned int span;  /* defaults to width */
+	enum hist_agg agg;
+	double lo, hi;
+};
+
+/* raw samples in a ring of a power of two, NAN where there was no value */
+struct hist {
+	double *v;
+	size_t mask;
+	uint64_t n; /* samples pushed so far */
+};
+
+void hist_init(struct hist *h, size_t span);
+void hist_fini(struct hist *h);
+void hist_push(struct hist *h, double v);
+const char *hist_render(const struct hist *h, const struct hist_spec *s);
@@ -0,0 +1,109 @@
+/* See LICENSE file for copyright and license details. */
+#include "meminfo.h"
+#include "parse.h"
+#include "util.h"
+
+#include <err.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__linux__)
+/*
+ * Perfect hash of the known keys, from their 4th and last character and
+ * their length. The slots are computed by the compiler from the same
+ * macro; two keys in one slot trigger -Woverride-init.
+ */
+#define KEYHASH(c3, clast, len) (((c3) * 6 + (clast) * 10 + (len)) % 16)
+
+static const struct {
+	const char *key;
+	int field;
+} keys[16] = {
+	[KEYHASH('T', 'l', 8)]  = { "MemTotal",     MEM_TOTAL        },
+	[KEYHASH('F', 'e', 7)]  = { "MemFree",      MEM_FREE         },
+	[KEYHASH('A', 'e', 12)] = { "MemAvailable", MEM_AVAILABLE    },
+	[KEYHASH('f', 's', 7)]  = { "Buffers",      MEM_BUFFERS      },
+	[KEYHASH('h', 'd', 6)]  = { "Cached",       MEM_CACHED       },
+	[KEYHASH('e', 'm', 5)]  = { "Shmem",        MEM_SHMEM        },
+	[KEYHASH('c', 'e', 12)] = { "SReclaimable", MEM_SRECLAIMABLE },
+	[KEYHASH('t', 'y', 5)]  = { "Dirty",        MEM_DIRTY        },
+	[KEYHASH('t', 'k', 9)]  = { "Writeback",    MEM_WRITEBACK    },
+	[KEYHASH('p', 'l', 9)]  = { "SwapTotal",    SWAP_TOTAL       },
+	[KEYHASH('p', 'e', 8)]  = { "SwapFree",     SWAP_FREE        },
+	[KEYHASH('p', 'd', 10)] = { "SwapCached",   SWAP_CACHED      },
+};
+
+static int
+lookup(const char *key, size_t len)
+{
+	size_t h;
+
+	if (len < 4)
+		return -1;
+	h = KEYHASH((unsigned char)key[3], (unsigned char)key[len - 1], len);
+
+	if (!keys[h].key || strncmp(keys[h].key, key, len) || keys[h].key[len])
+		return -1;
+
+	return keys[h].field;
+}
+
+static int
+parse(struct meminfo *mi, const char *text)
+{
+	const char *colon, *nl;
+	struct parser ps;
+	uintmax_t v;
+	int field;
+
+	parse_init(&ps, "/proc/meminfo", text);
+	mi->found = 0;
+
+	for (; *ps.p; ps.p = nl ? nl + 1 : ps.p + strlen(ps.p)) {
+		nl = strchr(ps.p, '\n');
+		if (!(colon = strchr(ps.p, ':')) || (nl && colon > nl))
+			continue;
+		if ((field = lookup(ps.p, colon - ps.p)) < 0)
+			continue;
+
+		ps.p = colon + 1;
+		if (parse_uint(&ps, &v) < 0)
+			return -1;
+		while (*ps.p == ' ')
+			ps.p++;
+		mi->bytes[field] = strncmp(ps.p, "kB", 2) ? v : v * 1024;
+		mi->found |= MI(field);
+	}
+
+	return 0;
+}
+
+/*
+ * Return the fields of /proc/meminfo, in bytes, as of the current update
+ * pass, whatever their order in the file. The file is parsed once per pass
+ * and thread. Returns NULL if any of the fields in need is missing.
+ */
+const struct meminfo *
+meminfo(unsigned int need)
+{
+	static thread_local struct meminfo mi;
+	static thread_local uint64_t updated;
+	static thread_local int ok;
+	const char *text;
+	size_t i;
+
+	if (stale(&updated))
+		ok = (text = snapshot("/proc/meminfo")) && parse(&mi, text) == 0;
+	if (!ok)
+		return NULL;
+
+	if ((mi.found & need) != need) {
+		for (i = 0; i < LEN(keys); i++)
+			if (keys[i].key && (need & ~mi.found & MI(keys[i].field)))
+				warnx("/proc/meminfo: missing '%s'", keys[i].key);
+		return NULL;
+	}
+
+	return &mi;
+}
+#endif
@@ -0,0 +1,31 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stdint.h>
+
+/* fields of /proc/meminfo */
+enum {
+	MEM_TOTAL,
+	MEM_FREE,
+	MEM_AVAILABLE,
+	MEM_BUFFERS,
+	MEM_CACHED,
+	MEM_SHMEM,
+	MEM_SRECLAIMABLE,
+	MEM_DIRTY,
+	MEM_WRITEBACK,
+	SWAP_TOTAL,
+	SWAP_FREE,
+	SWAP_CACHED,
+	MEMINFO_FIELDS
+};
+
+/* bit of a field in meminfo() and struct meminfo.found */
+#define MI(field) (1U << (field))
+
+struct meminfo {
+	uintmax_t bytes[MEMINFO_FIELDS];
+	unsigned int found;
+};
+
+const struct meminfo *meminfo(unsigned int need);
@@ -0,0 +1,359 @@
+/* See LICENSE file for copyright and license details. */
+#include "parse.h"
+#include "util.h"
+
+#include <err.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+#endif
+
+/* maximum size of a file read by readuint() */
+#define UINT_TEXT_MAX 64
+
+/* numbers of up to this many digits cannot overflow uintmax_t */
+#define SAFE_DIGITS 19
+
+static size_t scan_scalar(const char **p, const char *end, uintmax_t *v,
+                          size_t n);
+
+/* row scanner picked for this CPU, see select_scan() */
+static size_t (*scan)(const char **p, const char *end, uintmax_t *v,
+                      size_t n) = scan_scalar;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static int
+fail(const struct parser *ps, const char *fmt, ...)
+{
+	const char *q, *bol = ps->text;
+	char msg[128];
+	size_t line = 1;
+	va_list ap;
+
+	for (q = ps->text; q < ps->p; q++) {
+		if (*q == '\n') {
+			line++;
+			bol = q + 1;
+		}
+	}
+
+	va_start(ap, fmt);
+	(void)vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	warnx("%s:%zu:%zu: %s", ps->path, line, (size_t)(ps->p - bol) + 1, msg);
+
+	return -1;
+}
+
+static void
+skip_blanks(struct parser *ps)
+{
+	while (*ps->p == ' ' || *ps->p == '\t')
+		ps->p++;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* value of eight digits loaded from memory, combining pairs, quads, octets */
+static uint64_t
+swar(uint64_t w)
+{
+	w = (w & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+	w = (w & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+	w = (w & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+
+	return (uint32_t)w;
+}
+
+/* value of the first k <= 8 of eight digits, by shifting in leading zeros */
+static uint64_t
+swar_head(const char *p, size_t k)
+{
+	uint64_t w;
+
+	memcpy(&w, p, sizeof(w));
+
+	return swar(w << 8 * (8 - k));
+}
+#endif
+
+/*
+ * Value of len <= SAFE_DIGITS digits at p. If the text is long enough, the
+ * short head of a number is loaded as a whole word as well, taking in the
+ * bytes after it up to the terminating NUL at end.
+ */
+static uintmax_t
+convert(const char *p, size_t len, const char *end)
+{
+	uintmax_t v = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const size_t head = len % 8;
+	uint64_t w;
+
+	if (head && end - p >= 8 - 1) {
+		v = swar_head(p, head);
+		p += head;
+		len -= head;
+	}
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&w, p, sizeof(w));
+		v = v * 100000000 + swar(w);
+	}
+#endif
+	for (; len; p++, len--)
+		v = v * 10 + (*p - '0');
+
+	return v;
+}
+
+static size_t
+scan_scalar(const char **p, const char *end, uintmax_t *v, size_t n)
+{
+	const char *q = *p, *d;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		while (*q == ' ' || *q == '\t')
+			q++;
+		for (d = q; *d >= '0' && *d <= '9'; d++)
+			;
+		if (d == q || d - q > SAFE_DIGITS)
+			break;
+		v[i] = convert(q, d - q, end);
+		q = d;
+	}
+	*p = q;
+
+	return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * The vector scanners classify a block of text at a time, loaded unaligned
+ * from the cursor on, as long as the whole block lies within the text up to
+ * and including its terminating NUL; the rest is left to scan_scalar().
+ * Bit i of the masks stands for byte i of the block; the bits above the
+ * block are clear in the masks of digits and blanks, which stops any run.
+ * The count of numbers is or'ed with STOPPED if anything else was hit.
+ */
+#define STOPPED ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+static size_t
+scan_masks(const char **p, const char *text_end, uintmax_t *v, size_t n,
+           unsigned int width, uint64_t digit, uint64_t blank)
+{
+	const char *a = *p;
+	unsigned int pos = 0, end;
+	size_t len, i = 0;
+
+	while (i < n) {
+		/* skip blanks up to the next word */
+		pos = __builtin_ctzll(~blank & ~0ULL << pos);
+		if (pos >= width)
+			break;
+		if (!(digit >> pos & 1)) {
+			*p = a + pos;
+			return i | STOPPED;
+		}
+
+		if ((end = __builtin_ctzll(~digit & ~0ULL << pos)) >= width) {
+			/* the number continues in the next block */
+			for (len = width - pos; a[pos + len] >= '0' &&
+			     a[pos + len] <= '9'; len++)
+				;
+		} else {
+			len = end - pos;
+		}
+		if (len > SAFE_DIGITS) {
+			*p = a + pos;
+			return i | STOPPED;
+		}
+		v[i++] = convert(a + pos, len, text_end);
+		if ((pos += len) >= width) {
+			*p = a + pos;
+			return i;
+		}
+	}
+	*p = a + pos;
+
+	return i;
+}
+
+__attribute__((target("sse2"))) static size_t
+scan_sse2(const char **p, const char *end, uintmax_t *v, size_t n)
+{
+	size_t i = 0, r;
+	__m128i b, d, s;
+
+	while (i < n) {
+		if (end - *p < 16 - 1)
+			return i + scan_scalar(p, end, v + i, n - i);
+		b = _mm_loadu_si128((const __m128i *)*p);
+		d = _mm_and_si128(_mm_cmpgt_epi8(b, _mm_set1_epi8('0' - 1)),
+		                  _mm_cmplt_epi8(b, _mm_set1_epi8('9' + 1)));
+		s = _mm_or_si128(_mm_cmpeq_epi8(b, _mm_set1_epi8(' ')),
+		                 _mm_cmpeq_epi8(b, _mm_set1_epi8('\t')));
+		r = scan_masks(p, end, v + i, n - i, 16,
+		               (uint16_t)_mm_movemask_epi8(d),
+		               (uint16_t)_mm_movemask_epi8(s));
+		i += r & ~STOPPED;
+		if (r & STOPPED)
+			break;
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+scan_avx2(const char **p, const char *end, uintmax_t *v, size_t n)
+{
+	size_t i = 0, r;
+	__m256i b, d, s;
+
+	while (i < n) {
+		if (end - *p < 32 - 1)
+			return i + scan_scalar(p, end, v + i, n - i);
+		b = _mm256_loadu_si256((const __m256i *)*p);
+		d = _mm256_and_si256(_mm256_cmpgt_epi8(b, _mm256_set1_epi8('0' - 1)),
+		                     _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), b));
+		s = _mm256_or_si256(_mm256_cmpeq_epi8(b, _mm256_set1_epi8(' ')),
+		                    _mm256_cmpeq_epi8(b, _mm256_set1_epi8('\t')));
+		r = scan_masks(p, end, v + i, n - i, 32,
+		               (uint32_t)_mm256_movemask_epi8(d),
+		               (uint32_t)_mm256_movemask_epi8(s));
+		i += r & ~STOPPED;
+		if (r & STOPPED)
+			break;
+	}
+
+	return i;
+}
+#endif
+
+/* pick the widest row scanner the CPU supports */
+static void
+select_scan(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		scan = scan_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		scan = scan_sse2;
+#endif
+}
+
+void
+parse_init(struct parser *ps, const char *path, const char *text)
+{
+	pthread_once(&once, select_scan);
+	ps->path = path;
+	ps->text = text;
+	ps->end = text + strlen(text);
+	ps->p = text;
+}
+
+/* parse a decimal number, skipping blanks in front of it */
+int
+parse_uint(struct parser *ps, uintmax_t *v)
+{
+	uintmax_t n = 0;
+	unsigned int d;
+
+	skip_blanks(ps);
+	if (*ps->p < '0' || *ps->p > '9')
+		return fail(ps, "expected a number");
+
+	for (; (d = (unsigned char)*ps->p - '0') <= 9; ps->p++) {
+		if (n > (UINTMAX_MAX - d) / 10)
+			return fail(ps, "number out of range");
+		n = n * 10 + d;
+	}
+	*v = n;
+
+	return 0;
+}
+
+/*
+ * Parse up to n numbers separated by blanks on the current line, stopping
+ * quietly at anything else. Returns how many were parsed.
+ */
+size_t
+parse_nums(struct parser *ps, uintmax_t *v, size_t n)
+{
+	size_t i = 0;
+
+	for (;;) {
+		i += scan(&ps->p, ps->end, v + i, n - i);
+		/* the scanners leave numbers that might overflow to us */
+		skip_blanks(ps);
+		if (i == n || *ps->p < '0' || *ps->p > '9' ||
+		    parse_uint(ps, &v[i]) < 0)
+			return i;
+		i++;
+	}
+}
+
+/* parse n numbers separated by blanks on the current line */
+int
+parse_row(struct parser *ps, uintmax_t *v, size_t n)
+{
+	if (parse_nums(ps, v, n) == n)
+		return 0;
+
+	/* numbers out of range have been reported already */
+	if (*ps->p < '0' || *ps->p > '9')
+		return fail(ps, "expected a number");
+
+	return -1;
+}
+
+/* expect a word, such as the label at the start of a row */
+int
+parse_word(struct parser *ps, const char *word)
+{
+	const size_t len = strlen(word);
+
+	skip_blanks(ps);
+	if (strncmp(ps->p, word, len) ||
+	    (ps->p[len] != ' ' && ps->p[len] != '\t'))
+		return fail(ps, "expected '%s'", word);
+	ps->p += len;
+
+	return 0;
+}
+
+/* skip to the start of the next line */
+void
+parse_line(struct parser *ps)
+{
+	const char *nl;
+
+	if ((nl = strchr(ps->p, '\n')))
+		ps->p = nl + 1;
+	else
+		ps->p += strlen(ps->p);
+}
+
+/* read a file that holds a single number, such as a sysfs attribute */
+int
+readuint(const char *path, uintmax_t *v)
+{
+	char text[UINT_TEXT_MAX];
+	struct parser ps;
+
+	if (readfile(path, text, sizeof(text)) < 0)
+		return -1;
+
+	parse_init(&ps, path, text);
+	if (parse_uint(&ps, v) < 0)
+		return -1;
+	skip_blanks(&ps);
+	if (*ps.p && *ps.p != '\n')
+		return fail(&ps, "unexpected '%c'", *ps.p);
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A cursor over the text of a procfs or sysfs file. Parse errors are
+ * reported with the path and the line and column at which they occurred.
+ */
+struct parser {
+	const char *path;
+	const char *text;
+	const char *end; /* the terminating NUL, no byte past it is read */
+	const char *p;
+};
+
+void parse_init(struct parser *ps, const char *path, const char *text);
+int parse_uint(struct parser *ps, uintmax_t *v);
+int parse_row(struct parser *ps, uintmax_t *v, size_t n);
+size_t parse_nums(struct parser *ps, uintmax_t *v, size_t n);
+int parse_word(struct parser *ps, const char *word);
+void parse_line(struct parser *ps);
+int readuint(const char *path, uintmax_t *v);
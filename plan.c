@@ -0,0 +1,118 @@
+/* See LICENSE file for copyright and license details. */
+#include "plan.h"
+
+#include <err.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* upper bound for widths and precisions */
+#define PLAN_NUM_MAX 4096
+
+static size_t
+number(const char **f)
+{
+	size_t n = 0;
+
+	for (; **f >= '0' && **f <= '9'; (*f)++)
+		if ((n = n * 10 + (**f - '0')) > PLAN_NUM_MAX)
+			n = PLAN_NUM_MAX + 1;
+
+	return n;
+}
+
+/*
+ * Compile a format of the form "literal%[-][width][.precision]sliteral".
+ * The conversion is optional; "%%" stands for a literal '%'. Returns -1 if
+ * the format holds anything else.
+ */
+int
+plan_compile(struct plan *p, const char *fmt)
+{
+	const char *f;
+	char *q;
+
+	memset(p, 0, sizeof(*p));
+	p->prec = SIZE_MAX;
+	if (!(p->text = q = malloc(strlen(fmt) + 1)))
+		err(EXIT_FAILURE, "malloc");
+
+	for (f = fmt; *f; f++) {
+		if (*f != '%' || *++f == '%') {
+			*q++ = *f;
+			continue;
+		}
+		if (p->slot) {
+			warnx("Format '%s': More than one conversion", fmt);
+			return -1;
+		}
+		for (; *f == '-'; f++)
+			p->left = 1;
+		p->width = number(&f);
+		if (*f == '.') {
+			f++;
+			p->prec = number(&f);
+		}
+		if (*f != 's') {
+			warnx("Format '%s': Only %%s conversions are supported",
+			      fmt);
+			return -1;
+		}
+		if (p->width > PLAN_NUM_MAX ||
+		    (p->prec != SIZE_MAX && p->prec > PLAN_NUM_MAX)) {
+			warnx("Format '%s': Width or precision too large", fmt);
+			return -1;
+		}
+		p->prelen = q - p->text;
+		p->slot = 1;
+	}
+
+	if (p->slot)
+		p->postlen = q - p->text - p->prelen;
+	else
+		p->prelen = q - p->text;
+
+	return 0;
+}
+
+/*
+ * Write the format with the value into dst, like snprintf() would. Returns
+ * the length of the result or -1 if it does not fit.
+ */
+int
+plan_render(const struct plan *p, char *dst, size_t size, const char *value,
+            size_t vlen)
+{
+	size_t n = p->prelen + p->postlen, pad = 0;
+
+	if (p->slot) {
+		if (vlen > p->prec)
+			vlen = p->prec;
+		if (p->width > vlen)
+			pad = p->width - vlen;
+		n += vlen + pad;
+	} else {
+		vlen = 0;
+	}
+	if (n >= size) {
+		warnx("plan_render: Output truncated");
+		return -1;
+	}
+
+	memcpy(dst, p->text, p->prelen);
+	dst += p->prelen;
+	if (!p->left) {
+		memset(dst, ' ', pad);
+		dst += pad;
+	}
+	memcpy(dst, value, vlen);
+	dst += vlen;
+	if (p->left) {
+		memset(dst, ' ', pad);
+		dst += pad;
+	}
+	memcpy(dst, p->text + p->prelen, p->postlen);
+	dst[p->postlen] = '\0';
+
+	return n;
+}
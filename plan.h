@@ -0,0 +1,22 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * A printf format with at most one %s conversion, compiled into the
+ * literal text around the value and the width and precision of the value.
+ */
+struct plan {
+	char *text;      /* literal text, '%%' unescaped */
+	size_t prelen;   /* length of the text before the value */
+	size_t postlen;  /* length of the text after the value */
+	int slot;        /* whether the format has a %s conversion */
+	int left;        /* '-' flag */
+	size_t width;
+	size_t prec;     /* SIZE_MAX if not given */
+};
+
+int plan_compile(struct plan *p, const char *fmt);
+int plan_render(const struct plan *p, char *dst, size_t size,
+                const char *value, size_t vlen);
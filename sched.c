@@ -0,0 +1,63 @@
+/* See LICENSE file for copyright and license details. */
+#include "sched.h"
+
+#include <err.h>
+#include <stdlib.h>
+
+static int
+before(const struct deadline *a, const struct deadline *b)
+{
+	/* ties are broken by id so equal deadlines run in table order */
+	return a->when < b->when || (a->when == b->when && a->id < b->id);
+}
+
+void
+sched_push(struct sched *s, uint64_t when, size_t id)
+{
+	struct deadline d = { .when = when, .id = id };
+	size_t i, parent;
+
+	if (s->len == s->cap)
+		errx(EXIT_FAILURE, "sched_push: Heap is full");
+
+	for (i = s->len++; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (!before(&d, &s->heap[parent]))
+			break;
+		s->heap[i] = s->heap[parent];
+	}
+	s->heap[i] = d;
+}
+
+struct deadline
+sched_pop(struct sched *s)
+{
+	struct deadline top, last;
+	size_t i, child;
+
+	top = s->heap[0];
+	last = s->heap[--s->len];
+
+	for (i = 0; (child = 2 * i + 1) < s->len; i = child) {
+		if (child + 1 < s->len && before(&s->heap[child + 1], &s->heap[child]))
+			child++;
+		if (!before(&s->heap[child], &last))
+			break;
+		s->heap[i] = s->heap[child];
+	}
+	s->heap[i] = last;
+
+	return top;
+}
+
+const struct deadline *
+sched_peek(const struct sched *s)
+{
+	return s->len ? &s->heap[0] : NULL;
+}
+
+void
+sched_clear(struct sched *s)
+{
+	s->len = 0;
+}
@@ -0,0 +1,22 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct deadline {
+	uint64_t when; /* CLOCK_MONOTONIC, in ns */
+	size_t id;
+};
+
+/* binary min-heap of deadlines, backed by caller-provided storage */
+struct sched {
+	struct deadline *heap;
+	size_t len;
+	size_t cap;
+};
+
+void sched_push(struct sched *s, uint64_t when, size_t id);
+struct deadline sched_pop(struct sched *s);
+const struct deadline *sched_peek(const struct sched *s);
+void sched_clear(struct sched *s);
@@ -1,15 +1,21 @@
 /* See LICENSE file for copyright and license details. */
+#include "evloop.h"
+#include "hist.h"
+#include "plan.h"
+#include "sched.h"
 #include "slstatus.h"
 #include "util.h"
+#include "window.h"
+#include "worker.h"
 
 #include <err.h>
 #include <errno.h>
 #include <locale.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include <X11/Xlib.h>
@@ -18,56 +24,455 @@ struct component {
 	const char *(*func)(const char *);
 	const char *fmt;
 	const char *args;
+	unsigned int interval; /* in ms, 0 means the global interval */
+	unsigned int flags;
+	const struct component_ops *ops; /* per-entry state, see stateful[] */
+	struct hist_spec hist; /* show a sparkline of the values instead */
+	struct window_spec window; /* show the values combined over time */
 };
 
-char buf[1024];
-double delta_time = 0; // seconds
-static volatile sig_atomic_t done;
-static volatile sig_atomic_t reset_alarm = 1;
+/* component flags */
+#define F_INLINE  0x1 /* always run on the main thread */
+#define F_OFFLOAD 0x2 /* run on a worker thread */
+#define F_NODEDUP 0x4 /* never share the value with an identical entry */
+#define F_CONST   0x8 /* only update at startup and on SIGHUP */
+
+/* number of worker threads for offloaded components */
+#define WORKERS 2
+
+thread_local char buf[1024];
+thread_local double delta_time = 0; // seconds
+thread_local uint64_t tick;
+int verbose;
+static int done;
+static int refresh;
+static int reload;
+static int woken;
 static Display *dpy;
 
+/* trailing fields of struct component are optional in config.h */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
 #include "config.h"
+#pragma GCC diagnostic pop
+
+/* components that may block and are offloaded unless flagged F_INLINE */
+static const char *(*const blocking[])(const char *) = {
+	disk_free, disk_meter, disk_perc, disk_total, disk_used,
+	ipv4, ipv6, up,
+	keymap,
+	top_cpu, top_mem,
+	wifi_essid,
+};
+
+/* components that are constant unless given an interval */
+static const char *(*const invariant[])(const char *) = {
+	gid, hostname, kernel_release, uid, username,
+};
+
+/* components with per-entry state, used unless an entry sets ops itself */
+static const struct {
+	const char *(*func)(const char *);
+	const struct component_ops *ops;
+} stateful[] = {
+	{ clockdiff,      &clockdiff_ops      },
+	{ counter,        &counter_ops        },
+	{ cpu_cmeter,     &cpu_cmeter_ops     },
+	{ cpu_core_perc,  &cpu_core_perc_ops  },
+	{ cpu_cores,      &cpu_cores_ops      },
+	{ cpu_hist,       &cpu_hist_ops       },
+	{ cpu_max_perc,   &cpu_max_perc_ops   },
+	{ cpu_meter,      &cpu_meter_ops      },
+	{ cpu_perc,       &cpu_perc_ops       },
+	{ cpu_stack,      &cpu_stack_ops      },
+	{ cpu_state_perc, &cpu_state_perc_ops },
+	{ irq_rate,       &irq_rate_ops       },
+	{ netspeed_rx,    &netspeed_rx_ops    },
+	{ netspeed_tx,    &netspeed_tx_ops    },
+	{ psi_avg10,      &psi_avg10_ops      },
+	{ psi_rate,       &psi_rate_ops       },
+	{ ram_hist,       &ram_hist_ops       },
+	{ softirq_rate,   &softirq_rate_ops   },
+	{ swap_hist,      &swap_hist_ops      },
+	{ top_cpu,        &top_cpu_ops        },
+};
+
+/* last value of each component and its segment of the status text */
+static struct {
+	uint64_t last; /* time of the last update, in ns */
+	int shown; /* set once the segment has been formatted */
+	int woken; /* set by wakeup() */
+	size_t vlen;
+	char value[sizeof(buf)];
+	size_t off, len;
+	struct plan plan; /* compiled format */
+	const struct component_ops *ops;
+	void *state;
+	int constant; /* see F_CONST */
+	size_t lead; /* entry that is evaluated for this one */
+	size_t next; /* next entry that shows the value of this one */
+	struct job *job; /* set if the component is offloaded */
+	struct hist hist; /* of the lead, if the entry has a hist spec */
+	struct window window; /* of the lead, if the entry has a window spec */
+} slots[LEN(components)];
+
+static char status[MAXLEN];
+static size_t statuslen;
+static int changed;
+
+static struct deadline heap[LEN(components)];
+static struct sched sched = { .heap = heap, .cap = LEN(heap) };
+
+static uint64_t
+period(size_t i)
+{
+	return (components[i].interval ? components[i].interval : interval) *
+	       1000000ULL;
+}
+
+/* replace the segment of component i in the status text */
+static void
+splice(size_t i, const char *seg, size_t n)
+{
+	const size_t off = slots[i].off, old = slots[i].len;
+	size_t j;
+
+	if (n == old && !memcmp(status + off, seg, n))
+		return;
+
+	if (statuslen - old + n >= sizeof(status)) {
+		warnx("Status exceeds MAXLEN, dropping component %zu", i);
+		n = 0;
+	}
+
+	/* move the tail, including the terminating null character */
+	memmove(status + off + n, status + off + old, statuslen - off - old + 1);
+	memcpy(status + off, seg, n);
+	statuslen = statuslen - old + n;
+	slots[i].len = n;
+
+	for (j = i + 1; j < LEN(slots); j++)
+		slots[j].off = slots[j].off - old + n;
+
+	changed = 1;
+}
+
+static void
+apply(size_t i, const char *res)
+{
+	char seg[MAXLEN];
+	size_t n;
+	int ret;
+
+	if (!res)
+		res = unknown_str;
+
+	/* only reformat the segment if the raw value has changed */
+	n = strnlen(res, sizeof(slots[i].value) - 1);
+	if (slots[i].shown && n == slots[i].vlen &&
+	    !memcmp(slots[i].value, res, n))
+		return;
+	memcpy(slots[i].value, res, n);
+	slots[i].value[n] = '\0';
+	slots[i].vlen = n;
+	slots[i].shown = 1;
+
+	if ((ret = plan_render(&slots[i].plan, seg, sizeof(seg),
+	                       slots[i].value, n)) < 0)
+		ret = 0;
+	splice(i, seg, ret);
+}
+
+/* show a value in entry i and all entries that share it */
+static void
+deliver(size_t i, const char *res, struct numeric num)
+{
+	/* a window comes first, so a sparkline may show its values */
+	if (slots[i].window.s) {
+		window_push(&slots[i].window, slots[i].last, num.v);
+		num.v = window_value(&slots[i].window);
+		res = numeric_show(&num);
+	}
+	if (slots[i].hist.v) {
+		hist_push(&slots[i].hist, num.v);
+		res = hist_render(&slots[i].hist, &components[i].hist);
+	}
+
+	for (; i != SIZE_MAX; i = slots[i].next)
+		apply(i, res);
+}
+
+static void
+update(size_t i, uint64_t now)
+{
+	const double dt = (now - slots[i].last) / 1E9;
+	const char *res;
+
+	/* the result of an offloaded component is applied by collect() */
+	if (slots[i].job) {
+		if (job_submit(slots[i].job, now, dt) == 0)
+			slots[i].last = now;
+		return;
+	}
+
+	delta_time = dt;
+	tick = now;
+	slots[i].last = now;
+	if (slots[i].ops)
+		res = slots[i].ops->sample(slots[i].state);
+	else
+		res = components[i].func(components[i].args);
+	deliver(i, res, numeric_take(res));
+}
+
+/* update every entry of func with args on the next pass of the main loop */
+void
+wakeup(const char *(*func)(const char *), const char *args)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(components); i++) {
+		if (components[i].func == func && components[i].args == args) {
+			slots[slots[i].lead].woken = 1;
+			woken = 1;
+		}
+	}
+}
+
+static void
+collect(int fd, [[maybe_unused]] unsigned int events,
+        [[maybe_unused]] void *arg)
+{
+	char drain[64];
+	const char *res;
+	struct numeric num;
+	size_t i;
+
+	while (read(fd, drain, sizeof(drain)) > 0)
+		;
+
+	for (i = 0; i < LEN(slots); i++)
+		if (slots[i].job && job_result(slots[i].job, &res, &num))
+			deliver(i, res, num);
+}
+
+static int
+offloaded(size_t i)
+{
+	size_t j;
+
+	if (components[i].flags & F_INLINE)
+		return 0;
+	if (components[i].flags & F_OFFLOAD)
+		return 1;
+
+	for (j = 0; j < LEN(blocking); j++)
+		if (components[i].func == blocking[j])
+			return 1;
+
+	return 0;
+}
+
+static int
+constant(size_t i)
+{
+	size_t j;
+
+	if (components[i].flags & F_CONST)
+		return 1;
+	if (components[i].interval)
+		return 0;
+
+	for (j = 0; j < LEN(invariant); j++)
+		if (components[i].func == invariant[j])
+			return 1;
+
+	return 0;
+}
+
+static int
+same_hist(const struct hist_spec *a, const struct hist_spec *b)
+{
+	return a->width == b->width &&
+	       (!a->width || (MAX(a->span, a->width) == MAX(b->span, b->width) &&
+	                      a->agg == b->agg && a->lo == b->lo &&
+	                      a->hi == b->hi));
+}
+
+static int
+same_window(const struct window_spec *a, const struct window_spec *b)
+{
+	return a->secs == b->secs && (!a->secs || a->agg == b->agg);
+}
+
+/* whether entries i and j always produce the same value */
+static int
+same(size_t i, size_t j)
+{
+	const char *a = components[i].args, *b = components[j].args;
+
+	if ((components[i].flags | components[j].flags) & F_NODEDUP)
+		return 0;
+	if (slots[i].ops && (slots[i].ops->flags & CO_NODEDUP))
+		return 0;
+
+	return components[i].func == components[j].func &&
+	       slots[i].ops == slots[j].ops &&
+	       (a == b || (a && b && !strcmp(a, b))) &&
+	       period(i) == period(j) && offloaded(i) == offloaded(j) &&
+	       constant(i) == constant(j) &&
+	       same_hist(&components[i].hist, &components[j].hist) &&
+	       same_window(&components[i].window, &components[j].window);
+}
+
+/* compile the formats and set up the state of every entry */
+static void
+setup(void)
+{
+	size_t i, j, k;
+
+	for (i = 0; i < LEN(components); i++) {
+		if (plan_compile(&slots[i].plan, components[i].fmt) < 0)
+			errx(EXIT_FAILURE, "Invalid format of component %zu", i);
+
+		slots[i].ops = components[i].ops;
+		for (j = 0; j < LEN(stateful) && !slots[i].ops; j++)
+			if (components[i].func == stateful[j].func)
+				slots[i].ops = stateful[j].ops;
+
+		slots[i].constant = constant(i);
+
+		/* entries that show the same value share one evaluation */
+		slots[i].lead = i;
+		slots[i].next = SIZE_MAX;
+		for (j = 0; j < i; j++) {
+			if (slots[j].lead == j && same(i, j)) {
+				slots[i].lead = j;
+				for (k = j; slots[k].next != SIZE_MAX; k = slots[k].next)
+					;
+				slots[k].next = i;
+				break;
+			}
+		}
+
+		if (slots[i].lead == i && slots[i].ops &&
+		    slots[i].ops->init(components[i].args, &slots[i].state) < 0)
+			errx(EXIT_FAILURE, "Failed to initialize component %zu", i);
+		if (slots[i].lead == i && components[i].hist.width)
+			hist_init(&slots[i].hist, MAX(components[i].hist.span,
+			                              components[i].hist.width));
+		if (slots[i].lead == i && components[i].window.secs)
+			window_init(&slots[i].window, &components[i].window,
+			            period(i));
+	}
+}
 
 static void
-terminate(const int signo)
+teardown(void)
 {
-	if (signo == SIGALRM) {
+	size_t i;
+
+	/* the state of a job that is still running belongs to its worker */
+	for (i = 0; i < LEN(slots); i++) {
+		if (slots[i].lead == i && slots[i].ops && slots[i].ops->fini &&
+		    (!slots[i].job || job_idle(slots[i].job)))
+			slots[i].ops->fini(slots[i].state);
+		hist_fini(&slots[i].hist);
+		window_fini(&slots[i].window);
 	}
-	else if (signo == SIGUSR1) {
-		reset_alarm = 1;
+}
+
+static void
+offload(void)
+{
+	size_t i, n;
+	int fd;
+
+	for (i = n = 0; i < LEN(components); i++) {
+		if (slots[i].lead != i || !offloaded(i))
+			continue;
+		if (!(slots[i].job = malloc(sizeof(*slots[i].job))))
+			err(EXIT_FAILURE, "malloc");
+		job_init(slots[i].job, components[i].func, components[i].args);
+		if (slots[i].ops) {
+			slots[i].job->sample = slots[i].ops->sample;
+			slots[i].job->state = slots[i].state;
+		}
+		n++;
 	}
-	else {
+
+	if (!n)
+		return;
+
+	/* keymap talks to the X server from a worker thread */
+	if (!XInitThreads())
+		errx(EXIT_FAILURE, "XInitThreads: Failed to initialize threads");
+
+	if ((fd = workers_start(WORKERS)) < 0 ||
+	    ev_add(fd, EV_IN, collect, NULL) < 0)
+		errx(EXIT_FAILURE, "Failed to start the worker threads");
+}
+
+/* called from ev_wait(), not from signal context */
+static void
+onsignal(const int signo)
+{
+	if (signo == SIGCHLD)
+		run_reap();
+	else if (signo == SIGUSR1)
+		refresh = 1;
+	else if (signo == SIGHUP)
+		reload = 1;
+	else
 		done = 1;
+}
+
+static void
+onxevent([[maybe_unused]] int fd, [[maybe_unused]] unsigned int events,
+         [[maybe_unused]] void *arg)
+{
+	XEvent ev;
+
+	/* drain the queue; a lost connection exits via the I/O error handler */
+	while (XPending(dpy))
+		XNextEvent(dpy, &ev);
+}
+
+static void
+publish(int sflag)
+{
+	if (sflag) {
+		(void)puts(status);
+		(void)fflush(stdout);
+		if (ferror(stdout))
+			err(EXIT_FAILURE, "puts");
+	} else {
+		if (XStoreName(dpy, DefaultRootWindow(dpy), status) < 0)
+			errx(EXIT_FAILURE, "XStoreName: Allocation failed");
+		XFlush(dpy);
 	}
 }
 
 static void
 usage(const char* argv0)
 {
-	printf("Usage: %s [-V] [-h] [-1] [-s]\n", argv0);
+	printf("Usage: %s [-V] [-h] [-1] [-s] [-f] [-v]\n", argv0);
 }
 
 int
 main(int argc, char *argv[])
 {
 	int ch;
-	const char *optstring = "+Vh1s";
-	struct sigaction act;
-	sigset_t newmask, oldmask, waitmask;
-	const struct timeval interval_tv = msec_to_timeval(interval);
-	const struct itimerval itv = {
-	             .it_interval = interval_tv,
-	             .it_value = interval_tv}; // If zero, the alarm is disabled.
-	struct timespec start;
-	double now_time, prev_time = 0;
-	size_t i, len;
-	int sflag, ret;
-	char status[MAXLEN];
-	const char *res;
+	const char *optstring = "+Vh1sfv";
+	struct timespec ts;
+	struct deadline d;
+	uint64_t now, next;
+	size_t i;
+	int sflag, fflag, oneshot;
 
 	(void)setlocale(LC_CTYPE, "");
 
-	sflag = 0;
+	sflag = fflag = oneshot = 0;
 	while ((ch = getopt(argc, argv, optstring)) != -1) {
 		switch (ch) {
 		case 'V':
@@ -79,11 +484,17 @@ main(int argc, char *argv[])
 			return 0;
 			break;
 		case '1':
-			done = 1;
+			oneshot = 1;
 			/* FALLTHROUGH */
 		case 's':
 			sflag = 1;
 			break;
+		case 'f':
+			fflag = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
 		default:
 			usage(argv[0]);
 			return 1;
@@ -99,66 +510,96 @@ main(int argc, char *argv[])
 		return 1;
 	}
 
-	memset(&act, 0, sizeof(act));
-	sigemptyset(&act.sa_mask);
-	act.sa_handler = terminate;
-	sigaction(SIGINT,  &act, NULL);
-	sigaction(SIGTERM, &act, NULL);
-	act.sa_flags |= SA_RESTART;
-	sigaction(SIGALRM, &act, NULL);
-	sigaction(SIGUSR1, &act, NULL);
+	/* components may watch file descriptors from the start */
+	if (ev_init() < 0)
+		errx(EXIT_FAILURE, "Failed to set up the event loop");
 
-	if (!sflag && !(dpy = XOpenDisplay(NULL)))
-		errx(EXIT_FAILURE, "XOpenDisplay: Failed to open display");
+	setup();
 
-	sigemptyset(&waitmask);
-	sigfillset(&newmask);
-	sigprocmask(SIG_BLOCK, &newmask, &oldmask);
+	if (ev_signal(SIGINT, onsignal) < 0 ||
+	    ev_signal(SIGTERM, onsignal) < 0 ||
+	    ev_signal(SIGUSR1, onsignal) < 0 ||
+	    ev_signal(SIGHUP, onsignal) < 0 ||
+	    ev_signal(SIGCHLD, onsignal) < 0)
+		errx(EXIT_FAILURE, "Failed to set up the event loop");
 
-	do {
-		if (reset_alarm) {
-			if (setitimer(ITIMER_REAL, &itv, NULL) < 0) {
-				err(EXIT_FAILURE, "setitimer");
-			}
-			reset_alarm = 0;
-		}
+	/* everything runs inline when writing only once */
+	if (!oneshot)
+		offload();
+
+	if (!sflag) {
+		if (!(dpy = XOpenDisplay(NULL)))
+			errx(EXIT_FAILURE, "XOpenDisplay: Failed to open display");
+		if (ev_add(ConnectionNumber(dpy), EV_IN, onxevent, NULL) < 0)
+			errx(EXIT_FAILURE, "Failed to watch the X connection");
+	}
 
-		if (clock_gettime(CLOCK_MONOTONIC, &start) < 0)
+	refresh = reload = 1;
+
+	do {
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
 			err(EXIT_FAILURE, "clock_gettime");
 
-		now_time = timespec_to_sec(&start);
-		delta_time = now_time - prev_time;
-		prev_time = now_time;
+		now = timespec_to_nsec(&ts);
 
-		status[0] = '\0';
-		for (i = len = 0; i < LEN(components); i++) {
-			if (!(res = components[i].func(components[i].args)))
-				res = unknown_str;
+		if (refresh) {
+			sched_clear(&sched);
+			for (i = 0; i < LEN(components); i++)
+				if (slots[i].lead == i && !slots[i].constant)
+					sched_push(&sched, now, i);
+			refresh = 0;
+		}
 
-			if ((ret = esnprintf(status + len, sizeof(status) - len,
-			                     components[i].fmt, res)) < 0)
-				break;
+		/* constant components are evaluated here and nowhere else */
+		if (reload) {
+			for (i = 0; i < LEN(components); i++)
+				if (slots[i].lead == i && slots[i].constant)
+					update(i, now);
+			reload = 0;
+		}
 
-			len += ret;
+		/* only re-run the components that are due */
+		while (sched.len && sched_peek(&sched)->when <= now) {
+			d = sched_pop(&sched);
+			update(d.id, now);
+
+			/* keep the phase, but never schedule in the past */
+			next = d.when + period(d.id);
+			if (next <= now)
+				next = now + period(d.id);
+			sched_push(&sched, next, d.id);
 		}
+		if (oneshot)
+			sched_clear(&sched);
 
-		if (sflag) {
-			(void)puts(status);
-			(void)fflush(stdout);
-			if (ferror(stdout))
-				err(EXIT_FAILURE, "puts");
-		} else {
-			if (XStoreName(dpy, DefaultRootWindow(dpy), status) < 0)
-				errx(EXIT_FAILURE, "XStoreName: Allocation failed");
-			XFlush(dpy);
+		/* components that have pushed a new value in the meantime */
+		if (woken) {
+			for (i = 0; i < LEN(components); i++) {
+				if (slots[i].woken) {
+					slots[i].woken = 0;
+					update(i, now);
+				}
+			}
+			woken = 0;
 		}
 
-		if (!done) {
-			(void)sigsuspend(&waitmask);
+		/* with -1, wait for the commands started by the first pass */
+		if (oneshot && !run_pending())
+			done = 1;
+
+		/* only wake up the consumer when the text has changed */
+		if ((fflag || changed) && (done || !oneshot)) {
+			publish(sflag);
+			changed = 0;
 		}
+		/* sleep until the earliest component is due */
+		if (!done)
+			ev_wait(sched.len ? sched_peek(&sched)->when :
+			                    EV_FOREVER);
 	} while (!done);
 
-	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+	teardown();
+	ev_fini();
 
 	if (!sflag) {
 		XStoreName(dpy, DefaultRootWindow(dpy), NULL);
@@ -1,6 +1,26 @@
 /* See LICENSE file for copyright and license details. */
 #pragma once
 
+/* main loop */
+extern int verbose;
+void wakeup(const char *(*func)(const char *), const char *args);
+
+/*
+ * A component with state of its own for each entry of components[]. init
+ * validates the argument and allocates the state before the first update,
+ * sample produces the value from it and fini releases it. The plain
+ * function of such a component keeps a single shared state.
+ */
+struct component_ops {
+	int (*init)(const char *args, void **state);
+	const char *(*sample)(void *state);
+	void (*fini)(void *state);
+	unsigned int flags;
+};
+
+/* component_ops flags */
+#define CO_NODEDUP 0x1 /* every call has side effects, never share values */
+
 /* battery */
 const char *battery_meter(const char *);
 const char *battery_perc(const char *);
@@ -10,19 +30,34 @@ const char *battery_state(const char *);
 /* clocktime */
 const char *clockdiff(const char *unused);
 const char *clocktime(const char *unused);
+extern const struct component_ops clockdiff_ops;
 
 /* counter */
 const char *counter(const char *unused);
+extern const struct component_ops counter_ops;
 
 /* cat */
 const char *cat(const char *path);
 
 /* cpu */
 const char *cpu_cmeter(const char *unused);
+const char *cpu_core_perc(const char *core);
+const char *cpu_cores(const char *unused);
 const char *cpu_freq(const char *unused);
+const char *cpu_freq_avg(const char *unused);
+const char *cpu_freq_cores(const char *unused);
+const char *cpu_freq_max(const char *unused);
+const char *cpu_freq_min(const char *unused);
 const char *cpu_hist(const char *unused);
+const char *cpu_max_perc(const char *unused);
 const char *cpu_meter(const char *unused);
 const char *cpu_perc(const char *unused);
+const char *cpu_stack(const char *unused);
+const char *cpu_state_perc(const char *state);
+extern const struct component_ops cpu_cmeter_ops, cpu_core_perc_ops,
+                                  cpu_cores_ops, cpu_hist_ops, cpu_max_perc_ops,
+                                  cpu_meter_ops, cpu_perc_ops, cpu_stack_ops,
+                                  cpu_state_perc_ops;
 
 /* datetime */
 const char *datetime(const char *fmt);
@@ -40,6 +75,11 @@ const char *entropy(const char *unused);
 /* hostname */
 const char *hostname(const char *unused);
 
+/* interrupts */
+const char *irq_rate(const char *cpu);
+const char *softirq_rate(const char *cpu);
+extern const struct component_ops irq_rate_ops, softirq_rate_ops;
+
 /* ip */
 const char *ipv4(const char *interface);
 const char *ipv6(const char *interface);
@@ -60,10 +100,16 @@ const char *load_avg(const char *unused);
 /* netspeeds */
 const char *netspeed_rx(const char *interface);
 const char *netspeed_tx(const char *interface);
+extern const struct component_ops netspeed_rx_ops, netspeed_tx_ops;
 
 /* num_files */
 const char *num_files(const char *path);
 
+/* pressure */
+const char *psi_avg10(const char *args);
+const char *psi_rate(const char *args);
+extern const struct component_ops psi_avg10_ops, psi_rate_ops;
+
 /* ram */
 const char *ram_free(const char *unused);
 const char *ram_hist(const char *unused);
@@ -71,9 +117,13 @@ const char *ram_meter(const char *unused);
 const char *ram_perc(const char *unused);
 const char *ram_total(const char *unused);
 const char *ram_used(const char *unused);
+extern const struct component_ops ram_hist_ops;
 
 /* run_command */
 const char *run_command(const char *cmd);
+const char *run_coproc(const char *cmd);
+int run_pending(void);
+void run_reap(void);
 
 /* separator */
 const char *separator(const char *separator);
@@ -85,10 +135,16 @@ const char *swap_meter(const char *unused);
 const char *swap_perc(const char *unused);
 const char *swap_total(const char *unused);
 const char *swap_used(const char *unused);
+extern const struct component_ops swap_hist_ops;
 
 /* temperature */
 const char *temp(const char *);
 
+/* top */
+const char *top_cpu(const char *count);
+const char *top_mem(const char *count);
+extern const struct component_ops top_cpu_ops;
+
 /* uptime */
 const char *uptime(const char *unused);
 
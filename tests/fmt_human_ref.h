@@ -0,0 +1,52 @@
+/* See LICENSE file for copyright and license details. */
+
+/*
+ * The previous fmt_human() and fmt_human_3(), which scale the number in
+ * long double, as the reference for the integer ones. Include after
+ * util.c, whose prefixes() they use.
+ */
+
+static char ref[64];
+
+static const char *
+ref_human(uintmax_t num, int base)
+{
+	long double scaled;
+	size_t i, prefixlen;
+	const char **prefix;
+
+	if (!(prefix = prefixes(base, &prefixlen)))
+		return NULL;
+
+	scaled = num;
+	for (i = 0; i < prefixlen && scaled >= base; i++)
+		scaled /= base;
+
+	(void)snprintf(ref, sizeof(ref), "%.1Lf %s", scaled, prefix[i]);
+
+	return ref;
+}
+
+static const char *
+ref_human_3(uintmax_t num, int base)
+{
+	long double scaled;
+	size_t i, prefixlen;
+	const char **prefix;
+	int precision = 3;
+
+	if (!(prefix = prefixes(base, &prefixlen)))
+		return NULL;
+
+	scaled = num;
+	for (i = 0; i < prefixlen && scaled >= 999.5L; i++)
+		scaled /= base;
+
+	if (scaled < 1)
+		--precision;
+
+	(void)snprintf(ref, sizeof(ref), "%.*Lg %s", precision, scaled,
+	               prefix[i]);
+
+	return ref;
+}
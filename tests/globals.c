@@ -0,0 +1,8 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdint.h>
+
+/* globals of slstatus.c that the units under test refer to */
+thread_local char buf[1024];
+thread_local uint64_t tick;
+thread_local double delta_time;
+int verbose;
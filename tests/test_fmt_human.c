@@ -0,0 +1,76 @@
+/* See LICENSE file for copyright and license details. */
+#include "../util.c"
+#include "fmt_human_ref.h"
+
+/* numbers counted up from 0, and around each multiple of a power of base */
+#define LOW  (1U << 20)
+#define NEAR 5000
+
+/* random numbers of random bit length */
+#define RANDOM 1000000
+
+static const int bases[] = { 1000, 1024 };
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t
+rnd(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed;
+}
+
+static void
+check(uintmax_t num)
+{
+	size_t i;
+
+	for (i = 0; i < LEN(bases); i++) {
+		if (strcmp(fmt_human(num, bases[i]), ref_human(num, bases[i])))
+			errx(EXIT_FAILURE, "fmt_human %ju %d: '%s', expected "
+			     "'%s'", num, bases[i], buf, ref);
+		if (strcmp(fmt_human_3(num, bases[i]),
+		           ref_human_3(num, bases[i])))
+			errx(EXIT_FAILURE, "fmt_human_3 %ju %d: '%s', expected "
+			     "'%s'", num, bases[i], buf, ref);
+	}
+}
+
+/*
+ * Compare with the long double formatters where rounding decides the
+ * prefix or the last digit: at the thresholds of 999.5, 1000 and 1024
+ * units and at the halves of the last digit shown.
+ */
+int
+main(void)
+{
+	static const uint64_t marks[] = { 9995, 99995, 999500, 1000000,
+	                                  1024000, 1023950 };
+	uint64_t p, k, v;
+	size_t b, i, j;
+
+	for (v = 0; v < LOW; v++)
+		check(v);
+
+	for (b = 0; b < LEN(bases); b++) {
+		for (p = 1; p <= UINT64_MAX / bases[b] / 1024; p *= bases[b]) {
+			for (i = 0; i < LEN(marks); i++) {
+				/* marks are in thousandths of a unit */
+				v = p / 1000 * marks[i] + p % 1000 * marks[i] / 1000;
+				for (k = 0; k < 2 * NEAR; k++)
+					if (v + k >= NEAR)
+						check(v + k - NEAR);
+			}
+		}
+	}
+
+	for (j = 0; j < RANDOM; j++)
+		check(rnd() >> rnd() % 64);
+	check(UINT64_MAX);
+	check(UINT64_MAX - 1);
+
+	return 0;
+}
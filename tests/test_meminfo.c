@@ -0,0 +1,21 @@
+/* See LICENSE file for copyright and license details. */
+#include "../meminfo.c"
+
+#include <stdlib.h>
+
+/* every key must be found in the slot its hash was typed in for */
+int
+main(void)
+{
+#if defined(__linux__)
+	size_t i;
+
+	for (i = 0; i < LEN(keys); i++)
+		if (keys[i].key &&
+		    lookup(keys[i].key, strlen(keys[i].key)) != keys[i].field)
+			errx(EXIT_FAILURE, "meminfo: '%s' does not hash to slot "
+			     "%zu", keys[i].key, i);
+#endif
+
+	return 0;
+}
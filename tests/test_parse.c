@@ -0,0 +1,150 @@
+/* See LICENSE file for copyright and license details. */
+#include "../parse.c"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* random rows per scanner and placement */
+#define ROWS 200000
+
+/* longest row generated, well below a page */
+#define ROW_MAX 512
+
+static uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+static unsigned int
+rnd(unsigned int n)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed % n;
+}
+
+/*
+ * A row of up to 12 numbers with blanks and tabs, some of more than
+ * SAFE_DIGITS digits but none out of range, sometimes cut short by a
+ * character that stops the scan.
+ */
+static size_t
+gen(char *q)
+{
+	size_t k = 0, t, i, nt = rnd(13), nb, nd;
+
+	for (t = 0; t < nt; t++) {
+		for (nb = rnd(t ? 6 : 3) + (t ? 1 : 0), i = 0; i < nb; i++)
+			q[k++] = rnd(5) ? ' ' : '\t';
+		if (!rnd(30))
+			q[k++] = "x:-\n"[rnd(4)];
+		if (!rnd(10)) {
+			/* 20 digits, below 1.8e19 */
+			q[k++] = '1';
+			q[k++] = '0' + rnd(8);
+			nd = 18;
+		} else {
+			nd = 1 + rnd(rnd(10) ? 12 : 19);
+		}
+		for (i = 0; i < nd; i++)
+			q[k++] = '0' + rnd(10);
+	}
+	if (rnd(2))
+		q[k++] = rnd(2) ? ' ' : '\n';
+	q[k] = '\0';
+
+	return k;
+}
+
+/* what parse_nums() must return, and where it must stop */
+static size_t
+reference(const char *q, uintmax_t *v, size_t n, const char **stop)
+{
+	const char *s;
+	char *e;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		for (s = q; *s == ' ' || *s == '\t'; s++)
+			;
+		if (*s < '0' || *s > '9')
+			break;
+		v[i] = strtoull(s, &e, 10);
+		q = e;
+	}
+	for (; *q == ' ' || *q == '\t'; q++)
+		;
+	*stop = q;
+
+	return i;
+}
+
+static void
+check(const char *name, const char *q)
+{
+	uintmax_t want[16], got[16];
+	const char *stop;
+	struct parser ps;
+	size_t nw, ng, i;
+
+	nw = reference(q, want, LEN(want), &stop);
+	parse_init(&ps, "fuzz", q);
+	ng = parse_nums(&ps, got, LEN(got));
+	skip_blanks(&ps);
+
+	for (i = 0; i < nw && i < ng && got[i] == want[i]; i++)
+		;
+	if (ng != nw || i != nw || ps.p != stop)
+		errx(EXIT_FAILURE, "parse %s: '%s': %zu numbers up to %td, "
+		     "expected %zu up to %td", name, q, ng, ps.p - q, nw,
+		     stop - q);
+}
+
+/*
+ * Compare a scanner with strtoull on rows placed right after a guard page
+ * and right before another, so that any read outside the text faults.
+ */
+static void
+fuzz(const char *name, size_t (*fn)(const char **, const char *,
+                                    uintmax_t *, size_t))
+{
+	const long pagesize = sysconf(_SC_PAGESIZE);
+	char row[ROW_MAX], *mem, *page;
+	size_t len, i;
+
+	if ((mem = mmap(NULL, 3 * pagesize, PROT_READ | PROT_WRITE,
+	                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+	page = mem + pagesize;
+	if (mprotect(mem, pagesize, PROT_NONE) < 0 ||
+	    mprotect(page + pagesize, pagesize, PROT_NONE) < 0)
+		err(EXIT_FAILURE, "mprotect");
+
+	scan = fn;
+	for (i = 0; i < ROWS; i++) {
+		len = gen(row);
+		memcpy(page, row, len + 1);
+		check(name, page);
+		memcpy(page + pagesize - len - 1, row, len + 1);
+		check(name, page + pagesize - len - 1);
+	}
+
+	(void)munmap(mem, 3 * pagesize);
+}
+
+int
+main(void)
+{
+	pthread_once(&once, select_scan);
+
+	fuzz("scalar", scan_scalar);
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("sse2"))
+		fuzz("sse2", scan_sse2);
+	if (__builtin_cpu_supports("avx2"))
+		fuzz("avx2", scan_avx2);
+#endif
+
+	return 0;
+}
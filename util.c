@@ -3,12 +3,47 @@
 
 #include <err.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <float.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+/* maximum number of files kept open by readfile(), per thread */
+#define FD_CACHE 32
+
+/* maximum size of the text parsed by pscanf() */
+#define PSCANF_MAX 4096
+
+static thread_local struct fdent {
+	char path[128];
+	int fd;
+} fds[FD_CACHE];
+static thread_local size_t nfds;
+
+/*
+ * Initial and maximum size of a snapshot. Buffers grow to fit files such
+ * as /proc/interrupts, which holds a column per CPU.
+ */
+#define SNAP_SIZE 65536
+#define SNAP_SIZE_MAX (16 * 1024 * 1024)
+
+/* files kept by snapshot(), per thread, one for every path ever asked for */
+static thread_local struct snap {
+	char *path;
+	uint64_t tick;
+	int ok;
+	char *text;
+	size_t size;
+} *snaps;
+static thread_local size_t nsnaps;
+
+/* raw value of the last result on this thread, see numeric_set() */
+static thread_local struct numeric numval = { .v = NAN };
 
 static const char *prefix_1000[] = { "", "k", "M", "G", "T", "P", "E", "Z",
                                      "Y" };
@@ -59,26 +94,247 @@ bprintf(const char *fmt, ...)
 	return (ret < 0) ? NULL : buf;
 }
 
-const char *
-fmt_human(uintmax_t num, int base)
+void *
+ecalloc(size_t nmemb, size_t size)
 {
-	long double scaled;
-	size_t i, prefixlen;
-	const char **prefix;
+	void *p;
 
+	if (!(p = calloc(nmemb, size)))
+		err(EXIT_FAILURE, "calloc");
+
+	return p;
+}
+
+static const char **
+prefixes(int base, size_t *prefixlen)
+{
 	switch (base) {
 	case 1000:
-		prefix = prefix_1000;
-		prefixlen = LEN(prefix_1000);
-		break;
+		*prefixlen = LEN(prefix_1000);
+		return prefix_1000;
 	case 1024:
-		prefix = prefix_1024;
-		prefixlen = LEN(prefix_1024);
-		break;
+		*prefixlen = LEN(prefix_1024);
+		return prefix_1024;
 	default:
 		warnx("fmt_human: Invalid base");
 		return NULL;
 	}
+}
+
+#if defined(__SIZEOF_INT128__) && LDBL_MANT_DIG <= 64 && \
+    UINTMAX_MAX == UINT64_MAX
+/*
+ * The number is scaled in integer arithmetic that rounds every step exactly
+ * like long double does, and the digits are rounded from the exact binary
+ * value like printf does, so the output is the same as that of
+ * printf("%.1Lf") and printf("%.3Lg") on the repeatedly divided number.
+ */
+
+__extension__ typedef unsigned __int128 u128;
+
+static const uint64_t powers_10[] = { 1, 10, 100, 1000 };
+
+/* a long double value m * 2^e, with m shifted up to 64 bits */
+struct fp {
+	uint64_t m;
+	int e;
+};
+
+static int
+bitlen(u128 q)
+{
+	const uint64_t hi = q >> 64;
+
+	if (hi)
+		return 128 - __builtin_clzll(hi);
+
+	return (uint64_t)q ? 64 - __builtin_clzll((uint64_t)q) : 0;
+}
+
+/*
+ * Round q * 2^e to LDBL_MANT_DIG bits, to nearest even. sticky is set if
+ * q was truncated, i.e. the exact value lies a bit above it.
+ */
+static struct fp
+fp_make(u128 q, int e, int sticky)
+{
+	const int s = bitlen(q) - LDBL_MANT_DIG;
+	u128 rem, half;
+	int n;
+
+	if (s > 0) {
+		rem = q & (((u128)1 << s) - 1);
+		half = (u128)1 << (s - 1);
+		q >>= s;
+		e += s;
+		if (rem > half || (rem == half && (sticky || (q & 1)))) {
+			if (++q >> LDBL_MANT_DIG) {
+				q >>= 1;
+				e++;
+			}
+		}
+	}
+	if (!q)
+		return (struct fp){ 0, 0 };
+
+	n = 64 - bitlen(q);
+
+	return (struct fp){ (uint64_t)q << n, e - n };
+}
+
+static struct fp
+fp_div(struct fp x, unsigned int base)
+{
+	const u128 n = (u128)x.m << 64;
+
+	/* division by a power of two is exact */
+	if (base == 1024)
+		return (struct fp){ x.m, x.m ? x.e - 10 : 0 };
+
+	return fp_make(n / base, x.e - 64, n % base != 0);
+}
+
+/* whether x >= num / 2 */
+static int
+fp_ge_half(struct fp x, unsigned int num)
+{
+	const int t = -(x.e + 1);
+
+	if (!x.m)
+		return 0;
+	if (t <= 0)
+		return 1;
+	if (t >= 128 - 12)
+		return 0;
+
+	return x.m >= ((u128)num << t);
+}
+
+/* x rounded down to an integer, x < 2^63 */
+static uint64_t
+fp_int(struct fp x)
+{
+	return -x.e >= 64 ? 0 : x.m >> -x.e;
+}
+
+/* x * scale rounded to nearest even, x < 2^63 */
+static uint64_t
+fp_round(struct fp x, uint64_t scale)
+{
+	const u128 t = (u128)x.m * scale;
+	const int s = -x.e;
+	u128 rem, half;
+	uint64_t d;
+
+	if (!x.m)
+		return 0;
+	if (s >= 128)
+		return 0;
+
+	d = t >> s;
+	rem = t & (((u128)1 << s) - 1);
+	half = (u128)1 << (s - 1);
+
+	return d + (rem > half || (rem == half && (d & 1)));
+}
+
+/*
+ * Write d / 10^frac with frac decimals and the prefix into buf. With strip,
+ * trailing zeros of the decimals are dropped like with %g.
+ */
+static const char *
+emit(uint64_t d, size_t frac, int strip, const char *prefix)
+{
+	char digits[24];
+	size_t i, lo = 0, n = 0, len;
+	char *p = buf;
+
+	do {
+		digits[n++] = '0' + d % 10;
+		d /= 10;
+	} while (d || n <= frac);
+
+	if (strip)
+		for (; frac > 0 && digits[lo] == '0'; lo++, frac--)
+			;
+
+	for (i = n; i-- > lo + frac;)
+		*p++ = digits[i];
+	if (frac) {
+		*p++ = '.';
+		for (i = lo + frac; i-- > lo;)
+			*p++ = digits[i];
+	}
+	*p++ = ' ';
+
+	len = strlen(prefix);
+	memcpy(p, prefix, len + 1);
+
+	return buf;
+}
+
+const char *
+fmt_human(uintmax_t num, int base)
+{
+	struct fp scaled;
+	size_t i, prefixlen;
+	const char **prefix;
+
+	numeric_set(num, fmt_human, base);
+
+	if (!(prefix = prefixes(base, &prefixlen)))
+		return NULL;
+
+	scaled = fp_make(num, 0, 0);
+	for (i = 0; i < prefixlen && fp_ge_half(scaled, 2 * base); i++)
+		scaled = fp_div(scaled, base);
+
+	return emit(fp_round(scaled, 10), 1, 0, prefix[i]);
+}
+
+const char *
+fmt_human_3(uintmax_t num, int base)
+{
+	struct fp scaled;
+	size_t i, prefixlen;
+	const char **prefix;
+	uint64_t d, n;
+	int precision = 3, exp;
+
+	numeric_set(num, fmt_human_3, base);
+
+	if (!(prefix = prefixes(base, &prefixlen)))
+		return NULL;
+
+	scaled = fp_make(num, 0, 0);
+	for (i = 0; i < prefixlen && fp_ge_half(scaled, 1999); i++)
+		scaled = fp_div(scaled, base);
+
+	if (!(n = fp_int(scaled)))
+		--precision;
+
+	/* decimal exponent of the leading significant digit, as with %g */
+	exp = n >= 100 ? 2 : n >= 10 ? 1 : n ? 0 : -1;
+	d = fp_round(scaled, powers_10[precision - 1 - exp]);
+	if (d == powers_10[precision]) {
+		d /= 10;
+		exp++;
+	}
+
+	return emit(d, precision - 1 - exp, 1, prefix[i]);
+}
+#else
+const char *
+fmt_human(uintmax_t num, int base)
+{
+	long double scaled;
+	size_t i, prefixlen;
+	const char **prefix;
+
+	numeric_set(num, fmt_human, base);
+
+	if (!(prefix = prefixes(base, &prefixlen)))
+		return NULL;
 
 	scaled = num;
 	for (i = 0; i < prefixlen && scaled >= base; i++)
@@ -95,19 +351,10 @@ fmt_human_3(uintmax_t num, int base)
 	const char **prefix;
 	int precision = 3;
 
-	switch (base) {
-	case 1000:
-		prefix = prefix_1000;
-		prefixlen = LEN(prefix_1000);
-		break;
-	case 1024:
-		prefix = prefix_1024;
-		prefixlen = LEN(prefix_1024);
-		break;
-	default:
-		warnx("fmt_human: Invalid base");
+	numeric_set(num, fmt_human_3, base);
+
+	if (!(prefix = prefixes(base, &prefixlen)))
 		return NULL;
-	}
 
 	scaled = num;
 	for (i = 0; i < prefixlen && scaled >= 999.5L; i++) {
@@ -120,39 +367,246 @@ fmt_human_3(uintmax_t num, int base)
 
 	return bprintf("%.*Lg %s", precision, scaled, prefix[i]);
 }
+#endif
+
+static int
+open_ro(const char *path)
+{
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		warn("open '%s'", path);
+
+	return fd;
+}
+
+/*
+ * Files of procfs and sysfs are regenerated on every read of the same open
+ * file. Other files may be replaced by a rename or be FIFOs, so they are
+ * opened afresh each time.
+ */
+static int
+cacheable(const char *path)
+{
+	return !strncmp(path, "/proc/", 6) || !strncmp(path, "/sys/", 5);
+}
+
+/*
+ * Read up to size - 1 bytes from the start of a file into dst and terminate
+ * them. Returns the number of bytes read or -1. Files under /proc and /sys
+ * are kept open and re-read with pread() by later calls from the same
+ * thread; they are reopened if they went away in the meantime, e.g. because
+ * a device was re-plugged.
+ */
+ssize_t
+readfile(const char *path, char *dst, size_t size)
+{
+	struct fdent *e;
+	ssize_t n;
+	int fd;
+
+	if (!cacheable(path)) {
+		if ((fd = open_ro(path)) < 0)
+			return -1;
+		if ((n = read(fd, dst, size - 1)) < 0)
+			warn("read '%s'", path);
+		(void)close(fd);
+		if (n < 0)
+			return -1;
+		dst[n] = '\0';
+
+		return n;
+	}
+
+	for (e = fds; e < fds + nfds && strcmp(e->path, path); e++)
+		;
+	if (e == fds + nfds) {
+		if ((fd = open_ro(path)) < 0)
+			return -1;
+		if (nfds < LEN(fds) && strlen(path) < sizeof(e->path)) {
+			memcpy(e->path, path, strlen(path) + 1);
+			e->fd = fd;
+			nfds++;
+		} else {
+			e = NULL;
+		}
+	} else {
+		fd = e->fd;
+	}
+
+	n = pread(fd, dst, size - 1, 0);
+	if (n < 0 && e && (errno == ENODEV || errno == ESTALE)) {
+		(void)close(fd);
+		if ((fd = e->fd = open_ro(path)) >= 0)
+			n = pread(fd, dst, size - 1, 0);
+	}
+	if (n < 0 && fd >= 0)
+		warn("pread '%s'", path);
+
+	if (!e) {
+		(void)close(fd);
+	} else if (n < 0) {
+		if (fd >= 0)
+			(void)close(fd);
+		*e = fds[--nfds];
+	}
+	if (n < 0)
+		return -1;
+	dst[n] = '\0';
+
+	return n;
+}
+
+/*
+ * Record the number behind the text a component is about to return, e.g.
+ * the bytes formatted by fmt_human(), and how it was printed, for the
+ * histories and windows of entries.
+ */
+void
+numeric_set(double v, const char *(*human)(uintmax_t, int), int base)
+{
+	numval = (struct numeric){ .v = v, .human = human, .base = base };
+}
+
+/*
+ * Take the number recorded for a result, or else the number the result
+ * starts with along with its number of decimals, or NAN if there is none.
+ */
+struct numeric
+numeric_take(const char *res)
+{
+	struct numeric n = numval;
+	const char *dot;
+	char *end;
+
+	numval = (struct numeric){ .v = NAN };
+	if (!res)
+		return (struct numeric){ .v = NAN };
+	if (!isnan(n.v))
+		return n;
+
+	n.v = strtod(res, &end);
+	if (end == res)
+		return (struct numeric){ .v = NAN };
+	if ((dot = memchr(res, '.', end - res)))
+		n.prec = strspn(dot + 1, "0123456789");
+
+	return n;
+}
+
+/* print a number the way it was printed when it was taken */
+const char *
+numeric_show(const struct numeric *n)
+{
+	const char *res;
+
+	if (isnan(n->v))
+		return NULL;
+	if (!n->human)
+		return bprintf("%.*f", n->prec, n->v);
+
+	res = n->human(n->v > 0 ? (uintmax_t)(n->v + 0.5) : 0, n->base);
+	numval = (struct numeric){ .v = NAN };
+
+	return res;
+}
 
 int
 pscanf(const char *path, const char *fmt, ...)
 {
-	FILE *fp;
+	char text[PSCANF_MAX];
 	va_list ap;
 	int n;
 
-	fp = fopen(path, "r");
-	if (fp == NULL) {
-		warn("fopen '%s'", path);
+	if (readfile(path, text, sizeof(text)) < 0)
 		return -1;
-	}
 	va_start(ap, fmt);
-	n = vfscanf(fp, fmt, ap);
+	n = vsscanf(text, fmt, ap);
 	va_end(ap);
-	if (fclose(fp) < 0)
-		err(EXIT_FAILURE, "fclose");
 
 	return (n == EOF) ? -1 : n;
 }
 
+/*
+ * Whether a value last read in the update pass *stamp must be read again
+ * in the current one, which *stamp is then set to. This keeps a file read
+ * by several components from being read more than once per pass.
+ */
+int
+stale(uint64_t *stamp)
+{
+	if (*stamp && *stamp == tick)
+		return 0;
+	*stamp = tick;
+
+	return 1;
+}
+
+/*
+ * Return the contents of a file as of the current update pass, or NULL on
+ * error. The file is read by the first caller of each pass only; all other
+ * callers on the same thread share that copy until the next pass.
+ */
+const char *
+snapshot(const char *path)
+{
+	const size_t len = strlen(path);
+	struct snap *s;
+	ssize_t n;
+	size_t i;
+	char *p;
+
+	for (i = 0; i < nsnaps && strcmp(snaps[i].path, path); i++)
+		;
+	s = &snaps[i];
+
+	/* the set of paths is fixed by the components, so this stays small */
+	if (i == nsnaps) {
+		if (!(s = realloc(snaps, (nsnaps + 1) * sizeof(*snaps)))) {
+			warn("realloc");
+			return NULL;
+		}
+		snaps = s;
+		s = &snaps[nsnaps++];
+		*s = (struct snap){ .path = ecalloc(1, len + 1) };
+		memcpy(s->path, path, len);
+	}
+
+	if (stale(&s->tick)) {
+		if (!s->text)
+			s->text = ecalloc(1, s->size = SNAP_SIZE);
+		while ((n = readfile(path, s->text, s->size)) >= 0 &&
+		       (size_t)n == s->size - 1 && s->size < SNAP_SIZE_MAX) {
+			if (!(p = realloc(s->text, s->size * 2))) {
+				warn("realloc");
+				break;
+			}
+			s->text = p;
+			s->size *= 2;
+		}
+		s->ok = n >= 0;
+	}
+
+	return s->ok ? s->text : NULL;
+}
+
 double
 timespec_to_sec(const struct timespec* ts)
 {
 	return ts->tv_sec + copysign(ts->tv_nsec, ts->tv_sec) / 1E9;
 }
 
-struct timeval
-msec_to_timeval(unsigned int msec)
+uint64_t
+timespec_to_nsec(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
+
+struct timespec
+nsec_to_timespec(uint64_t nsec)
 {
-	return (struct timeval){
-	    .tv_sec = msec / 1000U,
-	    .tv_usec = (msec % 1000U) * 1000UL,
+	return (struct timespec){
+	    .tv_sec = nsec / 1000000000ULL,
+	    .tv_nsec = nsec % 1000000000ULL,
 	};
 }
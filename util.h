@@ -3,17 +3,43 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include <time.h>
 
-extern char buf[1024];
+extern thread_local char buf[1024];
+
+/* time of the current update pass, see stale() and snapshot() */
+extern thread_local uint64_t tick;
+
+/* seconds since the previous update of the component being updated */
+extern thread_local double delta_time;
 
 #define LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define MAX(A, B) ((A) > (B) ? (A) : (B))
+#define MIN(A, B) ((A) < (B) ? (A) : (B))
 
 int esnprintf(char *str, size_t size, const char *fmt, ...);
 const char *bprintf(const char *fmt, ...);
+void *ecalloc(size_t nmemb, size_t size);
 const char *fmt_human(uintmax_t num, int base);
 const char *fmt_human_3(uintmax_t num, int base);
+
+/* the number behind the text of a result, see numeric_take() */
+struct numeric {
+	double v; /* NAN if there is none */
+	const char *(*human)(uintmax_t num, int base); /* that printed v */
+	int base;
+	int prec; /* decimals of the text, if printed otherwise */
+};
+
+void numeric_set(double v, const char *(*human)(uintmax_t, int), int base);
+struct numeric numeric_take(const char *res);
+const char *numeric_show(const struct numeric *n);
+ssize_t readfile(const char *path, char *dst, size_t size);
 int pscanf(const char *path, const char *fmt, ...);
+int stale(uint64_t *stamp);
+const char *snapshot(const char *path);
 
 double timespec_to_sec(const struct timespec *ts);
-struct timeval msec_to_timeval(unsigned int msec);
+uint64_t timespec_to_nsec(const struct timespec *ts);
+struct timespec nsec_to_timespec(uint64_t nsec);
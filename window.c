@@ -0,0 +1,104 @@
+/* See LICENSE file for copyright and license details. */
+#include "window.h"
+#include "util.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/* most samples kept for one window */
+#define WINDOW_SAMPLES_MAX 65536
+
+/*
+ * Size the ring for one sample per period, with room for a few early
+ * updates such as wakeups. If there are more, the oldest samples leave the
+ * window early.
+ */
+void
+window_init(struct window *w, const struct window_spec *s, uint64_t period)
+{
+	const uint64_t span = s->secs * 1000000000ULL;
+	const uint64_t want = span / MAX(period, 1) + 2;
+	size_t size = 1;
+
+	while (size < MIN(want, WINDOW_SAMPLES_MAX))
+		size <<= 1;
+	*w = (struct window){ .mask = size - 1, .span = span, .agg = s->agg };
+	w->s = ecalloc(size, sizeof(*w->s));
+	if (w->agg != WINDOW_AVG)
+		w->q = ecalloc(size, sizeof(*w->q));
+}
+
+void
+window_fini(struct window *w)
+{
+	free(w->s);
+	free(w->q);
+	w->s = NULL;
+	w->q = NULL;
+}
+
+static double
+at(const struct window *w, uint64_t i)
+{
+	return w->s[i & w->mask].v;
+}
+
+/* whether a sample of value v makes an older one of value old irrelevant */
+static int
+supersedes(const struct window *w, double v, double old)
+{
+	return w->agg == WINDOW_MIN ? v <= old : v >= old;
+}
+
+/*
+ * Drop the samples that have left the window and add v, unless it is NAN.
+ * Every sample enters and leaves the ring and the deque once, so this is
+ * O(1) amortised.
+ */
+void
+window_push(struct window *w, uint64_t now, double v)
+{
+	uint64_t i;
+
+	while (w->first < w->n &&
+	       (w->s[w->first & w->mask].t + w->span <= now ||
+	        (!isnan(v) && w->n - w->first > w->mask))) {
+		w->sum -= at(w, w->first++);
+		if (w->q && w->q[w->qfirst & w->mask] < w->first)
+			w->qfirst++;
+	}
+	if (w->first == w->n)
+		w->sum = 0;
+
+	if (isnan(v))
+		return;
+
+	w->s[w->n & w->mask] = (struct window_sample){ .t = now, .v = v };
+	if (w->q) {
+		while (w->qn > w->qfirst &&
+		       supersedes(w, v, at(w, w->q[(w->qn - 1) & w->mask])))
+			w->qn--;
+		w->q[w->qn++ & w->mask] = w->n;
+	}
+	w->n++;
+
+	/* sum up afresh once per round of the ring so no error builds up */
+	if (!(w->n & w->mask)) {
+		for (w->sum = 0, i = w->first; i < w->n; i++)
+			w->sum += at(w, i);
+	} else {
+		w->sum += v;
+	}
+}
+
+/* the combined value of the window, or NAN if it holds no samples */
+double
+window_value(const struct window *w)
+{
+	if (w->first == w->n)
+		return NAN;
+	if (w->agg == WINDOW_AVG)
+		return w->sum / (w->n - w->first);
+
+	return at(w, w->q[w->qfirst & w->mask]);
+}
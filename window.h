@@ -0,0 +1,43 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* how the values within a window are combined */
+enum window_agg {
+	WINDOW_AVG,
+	WINDOW_MIN,
+	WINDOW_MAX,
+};
+
+/* the values of the last secs seconds combined into one */
+struct window_spec {
+	unsigned int secs; /* 0 for none */
+	enum window_agg agg;
+};
+
+/*
+ * Samples within the window in a ring of a power of two, oldest first, and
+ * for WINDOW_MIN and WINDOW_MAX a deque of the samples that may still
+ * become the extreme, their values monotonic from the front.
+ */
+struct window {
+	struct window_sample {
+		uint64_t t; /* in ns */
+		double v;
+	} *s;
+	uint64_t *q;         /* numbers of samples */
+	size_t mask;
+	uint64_t first, n;   /* samples first up to n are in the window */
+	uint64_t qfirst, qn; /* so are entries qfirst up to qn of q */
+	double sum;
+	uint64_t span;       /* in ns */
+	enum window_agg agg;
+};
+
+void window_init(struct window *w, const struct window_spec *s,
+                 uint64_t period);
+void window_fini(struct window *w);
+void window_push(struct window *w, uint64_t now, double v);
+double window_value(const struct window *w);
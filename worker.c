@@ -0,0 +1,159 @@
+/* See LICENSE file for copyright and license details. */
+#include "worker.h"
+#include "util.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+/* set in job->mid while the middle buffer holds an unread result */
+#define FRESH 0x4U
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static struct job *head, *tail;
+static int notify[2] = { -1, -1 };
+
+static void
+publish(struct job *job, const char *res)
+{
+	size_t n = 0;
+
+	job->out[job->back].ok = res != NULL;
+	job->out[job->back].num = numeric_take(res);
+	if (res) {
+		n = strnlen(res, sizeof(job->out[0].value) - 1);
+		memcpy(job->out[job->back].value, res, n);
+	}
+	job->out[job->back].value[n] = '\0';
+
+	/* hand the back buffer over and take the old middle one in exchange */
+	job->back = atomic_exchange_explicit(&job->mid, job->back | FRESH,
+	                                     memory_order_acq_rel) & ~FRESH;
+}
+
+static void *
+work([[maybe_unused]] void *arg)
+{
+	struct job *job;
+	const char c = 0;
+
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		while (!head)
+			pthread_cond_wait(&cond, &lock);
+		job = head;
+		if (!(head = job->next))
+			tail = NULL;
+		pthread_mutex_unlock(&lock);
+
+		tick = job->tick;
+		delta_time = job->delta_time;
+		publish(job, job->sample ? job->sample(job->state) :
+		                           job->func(job->args));
+		atomic_store_explicit(&job->busy, 0, memory_order_release);
+
+		/* a full pipe already guarantees a wake-up */
+		(void)write(notify[1], &c, 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * Start n worker threads. Returns a file descriptor that becomes readable
+ * whenever a job has published a result; the caller must drain it.
+ */
+int
+workers_start(size_t n)
+{
+	pthread_t thread;
+	size_t i;
+
+	if (pipe(notify) < 0) {
+		warn("pipe");
+		return -1;
+	}
+	for (i = 0; i < LEN(notify); i++) {
+		if (fcntl(notify[i], F_SETFL, O_NONBLOCK) < 0 ||
+		    fcntl(notify[i], F_SETFD, FD_CLOEXEC) < 0) {
+			warn("fcntl");
+			return -1;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if ((errno = pthread_create(&thread, NULL, work, NULL))) {
+			warn("pthread_create");
+			return -1;
+		}
+		(void)pthread_detach(thread);
+	}
+
+	return notify[0];
+}
+
+void
+job_init(struct job *job, const char *(*func)(const char *), const char *args)
+{
+	memset(job, 0, sizeof(*job));
+	job->func = func;
+	job->args = args;
+	job->front = 0;
+	atomic_init(&job->mid, 1);
+	job->back = 2;
+	atomic_init(&job->busy, 0);
+}
+
+/* queue a job, unless its previous run has not finished yet */
+int
+job_submit(struct job *job, uint64_t now, double dt)
+{
+	if (atomic_load_explicit(&job->busy, memory_order_acquire))
+		return -1;
+
+	atomic_store_explicit(&job->busy, 1, memory_order_relaxed);
+	job->tick = now;
+	job->delta_time = dt;
+	job->next = NULL;
+
+	pthread_mutex_lock(&lock);
+	if (tail)
+		tail->next = job;
+	else
+		head = job;
+	tail = job;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&lock);
+
+	return 0;
+}
+
+/*
+ * Fetch the latest result of a job without blocking. Returns 1 and sets
+ * *value (NULL if the component failed) and its *num if a new result is
+ * available.
+ */
+int
+job_result(struct job *job, const char **value, struct numeric *num)
+{
+	if (!(atomic_load_explicit(&job->mid, memory_order_relaxed) & FRESH))
+		return 0;
+
+	job->front = atomic_exchange_explicit(&job->mid, job->front,
+	                                      memory_order_acq_rel) & ~FRESH;
+	*value = job->out[job->front].ok ? job->out[job->front].value : NULL;
+	*num = job->out[job->front].num;
+
+	return 1;
+}
+
+/* whether the worker is done with the job, so its state may be released */
+int
+job_idle(struct job *job)
+{
+	return !atomic_load_explicit(&job->busy, memory_order_acquire);
+}
@@ -0,0 +1,44 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+/* maximum length of a value produced on a worker thread */
+#define JOB_VALUE_MAX 1024
+
+/*
+ * A component evaluated on a worker thread. The worker publishes each
+ * result through a triple buffer, so that the main thread can pick up the
+ * latest one without ever blocking on the worker.
+ */
+struct job {
+	const char *(*func)(const char *);
+	const char *args;
+	const char *(*sample)(void *state); /* used instead of func if set */
+	void *state;
+	uint64_t tick;
+	double delta_time;
+
+	struct {
+		int ok;
+		struct numeric num; /* see numeric_take() */
+		char value[JOB_VALUE_MAX];
+	} out[3];
+	_Atomic unsigned int mid; /* shared index, see job_result() */
+	unsigned int back;        /* owned by the worker */
+	unsigned int front;       /* owned by the main thread */
+
+	atomic_int busy;
+	struct job *next;
+};
+
+int workers_start(size_t n);
+void job_init(struct job *job, const char *(*func)(const char *),
+              const char *args);
+int job_submit(struct job *job, uint64_t now, double dt);
+int job_result(struct job *job, const char **value, struct numeric *num);
+int job_idle(struct job *job);